@@ -1,9 +1,11 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 
 #include "css.h"
 #include "csg.h"
+#include "csir.h"
 
 CSGType CSGlongType, CSGboolType;
 char CSGcurlev;
@@ -480,6 +482,209 @@ void CSGDecode(void)
 }
 
 
+/*****************************************************************************/
+
+
+// growable byte buffer for the binary encoding
+typedef struct CSGBuffer {
+  unsigned char *data;
+  long len, cap;
+} CSGBuffer;
+
+static void PutByte(CSGBuffer *b, int c)
+{
+  if (b->len == b->cap) {
+    b->cap = (b->cap == 0) ? 4096 : 2 * b->cap;
+    b->data = realloc(b->data, b->cap);
+    assert(b->data != NULL);
+  }
+  b->data[b->len++] = c;
+}
+
+
+static void PutVarint(CSGBuffer *b, unsigned long long v)
+{
+  while (v >= 0x80) {
+    PutByte(b, (v & 0x7f) | 0x80);
+    v >>= 7;
+  }
+  PutByte(b, v);
+}
+
+
+static void PutSigned(CSGBuffer *b, long long v)
+{
+  PutVarint(b, ((unsigned long long)v << 1) ^ (unsigned long long)(v >> 63));
+}
+
+
+// names are interned into an open-addressing table; symtab[k] is the id + 1
+static char **symname;
+static int *symtab, symcnt, symcap;
+
+static int InternName(char *name)
+{
+  register unsigned int h, k;
+  register char *c;
+
+  if (2 * (symcnt + 1) > symcap) {
+    register int i, old = symcap;
+    register int *oldtab = symtab;
+    symcap = (symcap == 0) ? 256 : 2 * symcap;
+    symtab = calloc(symcap, sizeof(int));
+    symname = realloc(symname, symcap * sizeof(char *));
+    assert((symtab != NULL) && (symname != NULL));
+    for (i = 0; i < old; i++) {
+      if (oldtab[i] != 0) {
+        h = 5381;
+        for (c = symname[oldtab[i] - 1]; *c != '\0'; c++) h = h * 33 + *c;
+        for (k = h % symcap; symtab[k] != 0; k = (k + 1) % symcap);
+        symtab[k] = oldtab[i];
+      }
+    }
+    free(oldtab);
+  }
+  h = 5381;
+  for (c = name; *c != '\0'; c++) h = h * 33 + *c;
+  for (k = h % symcap; symtab[k] != 0; k = (k + 1) % symcap) {
+    if (strcmp(symname[symtab[k] - 1], name) == 0) return symtab[k] - 1;
+  }
+  symname[symcnt] = name;
+  symcnt++;
+  symtab[k] = symcnt;
+  return symcnt - 1;
+}
+
+
+// This function encodes an operand the way PrintNode prints it
+static void EncodeNode(CSGBuffer *b, CSGNode x)
+{
+  assert(x != NULL);
+  if (x == GP) {
+    PutByte(b, CSIRGP);
+  } else if (x == FP) {
+    PutByte(b, CSIRFP);
+  } else {
+    switch (x->class) {
+      case CSGVar:
+          if ((x->type == CSGlongType) && (x->lev == 1))
+              PutByte(b, CSIRVar);
+          else
+              PutByte(b, CSIRBase);
+          PutVarint(b, InternName(x->name)); PutSigned(b, x->val);
+          break;
+      case CSGConst: PutByte(b, CSIRConst); PutSigned(b, x->val); break;
+      case CSGFld: PutByte(b, CSIRField); PutVarint(b, InternName(x->name)); PutSigned(b, x->val); break;
+      case CSGInst: case CSGAddr: PutByte(b, CSIRReg); PutVarint(b, x->line); break;
+      case CSGProc: PutByte(b, CSIRLabel); PutVarint(b, x->true->line); break;
+      default: assert(0);
+    }
+  }
+}
+
+
+static void EncodeBrakNode(CSGBuffer *b, CSGNode x)
+{
+  assert((x != NULL) && (x->class == CSGInst));
+  PutByte(b, CSIRLabel);
+  PutVarint(b, x->line);
+}
+
+
+// This function writes the code in the binary format of csir.h instead of
+// the text of CSGDecode
+void CSGEncode(void)
+{
+  register CSGNode i;
+  register int cnt, prev, k;
+  CSGBuffer body = {NULL, 0, 0}, head = {NULL, 0, 0}, index = {NULL, 0, 0};
+  int funcs = 0;
+
+  // assign line numbers
+  cnt = 1;
+  i = code;
+  while (i != NULL) {
+    i->line = cnt;
+    cnt++;
+    i = i->nxt;
+  }
+
+  prev = 0;
+  i = code;
+  while (i != NULL) {
+    if (i->op == ienter) {
+      PutVarint(&index, i->line);
+      PutVarint(&index, body.len);
+      funcs++;
+    }
+    switch (i->op) {
+      case iadd: PutByte(&body, CSIRadd); break;
+      case isub: PutByte(&body, CSIRsub); break;
+      case imul: PutByte(&body, CSIRmul); break;
+      case idiv: PutByte(&body, CSIRdiv); break;
+      case imod: PutByte(&body, CSIRmod); break;
+      case ineg: PutByte(&body, CSIRneg); break;
+      case iparam: PutByte(&body, CSIRparam); break;
+      case ienter: PutByte(&body, CSIRenter); break;
+      case ientrypc: PutByte(&body, CSIRentrypc); break;
+      case iret: PutByte(&body, CSIRret); break;
+      case icall: PutByte(&body, CSIRcall); break;
+      case ibr: PutByte(&body, CSIRbr); break;
+      case iblbc: PutByte(&body, CSIRblbc); break;
+      case iblbs: PutByte(&body, CSIRblbs); break;
+      case icmpeq: PutByte(&body, CSIRcmpeq); break;
+      case icmple: PutByte(&body, CSIRcmple); break;
+      case icmplt: PutByte(&body, CSIRcmplt); break;
+      case iread: PutByte(&body, CSIRread); break;
+      case iwrite: PutByte(&body, CSIRwrite); break;
+      case iwrl: PutByte(&body, CSIRwrl); break;
+      case iload: PutByte(&body, CSIRload); break;
+      case istore: PutByte(&body, CSIRstore); break;
+      case imove: PutByte(&body, CSIRmove); break;
+      case inop: PutByte(&body, CSIRnop); break;
+      default: assert(0);  // leave and end are never generated
+    }
+    PutVarint(&body, i->line - prev);
+    prev = i->line;
+    switch (i->op) {
+      case iadd: case isub: case imul: case idiv: case imod:
+      case icmpeq: case icmple: case icmplt:
+      case istore: case imove:
+        EncodeNode(&body, i->x); EncodeNode(&body, i->y); break;
+      case ineg: case iparam: case ienter: case iret: case icall:
+      case iwrite: case iload:
+        EncodeNode(&body, i->x); break;
+      case ibr: EncodeBrakNode(&body, i->x); break;
+      case iblbc: case iblbs: EncodeNode(&body, i->x); EncodeBrakNode(&body, i->y); break;
+      default: break;
+    }
+    i = i->nxt;
+  }
+
+  // the symbols are only known once the body is encoded
+  fwrite(CSIR_MAGIC, 1, 4, stdout);
+  PutByte(&head, CSIR_VERSION);
+  PutByte(&head, CSIRFunctionIndex);
+  PutVarint(&head, symcnt);
+  for (k = 0; k < symcnt; k++) {
+    register int len = strlen(symname[k]);
+    PutVarint(&head, len);
+    for (cnt = 0; cnt < len; cnt++) PutByte(&head, symname[k][cnt]);
+  }
+  PutVarint(&head, prev);  // lines run from 1 to the last one
+  PutVarint(&head, funcs);
+  fwrite(head.data, 1, head.len, stdout);
+  fwrite(index.data, 1, index.len, stdout);
+  head.len = 0;
+  PutVarint(&head, body.len);
+  fwrite(head.data, 1, head.len, stdout);
+  fwrite(body.data, 1, body.len, stdout);
+  free(head.data);
+  free(index.data);
+  free(body.data);
+}
+
+
 void CSGInit(void)
 {
   entrypc = NULL;
@@ -65,6 +65,7 @@ extern void CSGStart(int size);
 extern void CSGOpen(void);
 extern void CSGClose(void);
 extern void CSGDecode(void);
+extern void CSGEncode(void);
 extern void CSGInit(void);
 
 #endif /* _CSubCodeGen_H_ */
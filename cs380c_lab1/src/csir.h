@@ -0,0 +1,42 @@
+#ifndef _CSubIR_H_
+#define _CSubIR_H_
+
+/* Compact binary encoding of the 3-address code, written by "csc -binary"
+   and loaded by the lab2 optimizer as an alternative to the text format.
+
+   Integers are LEB128 varints; signed values are zigzag encoded first.
+
+     "CSIR" version:byte flags:byte
+     symbol count, then per symbol: length, name bytes
+     instruction count
+     if flags & CSIRFunctionIndex:
+       function count, then per function:
+         label of its enter, byte offset of its enter into the body
+     body length, then per instruction:
+       opcode:byte, label - previous label,
+       per operand (as many as the opcode takes): form:byte, payload
+
+   Operand payloads by form:
+     CSIRGP, CSIRFP      nothing
+     CSIRConst           value (signed)
+     CSIRReg, CSIRLabel  instruction label, written (n) and [n] in text
+     CSIRVar             symbol, offset (signed), written name#offset
+     CSIRBase            symbol, offset (signed), written name_base#offset
+     CSIRField           symbol, offset (signed), written name_offset#offset */
+
+#define CSIR_MAGIC "CSIR"
+#define CSIR_VERSION 1
+
+/* flags */
+enum {CSIRFunctionIndex = 1};
+
+/* opcode; numbered as the optimizer's Opcode::Type */
+enum {CSIRadd = 1, CSIRsub, CSIRmul, CSIRdiv, CSIRmod, CSIRneg, CSIRcmpeq,
+      CSIRcmple, CSIRcmplt, CSIRbr, CSIRblbc, CSIRblbs, CSIRload, CSIRstore,
+      CSIRmove, CSIRread, CSIRwrite, CSIRwrl, CSIRparam, CSIRenter,
+      CSIRentrypc, CSIRcall, CSIRret, CSIRnop};
+
+/* operand form */
+enum {CSIRGP, CSIRFP, CSIRConst, CSIRReg, CSIRLabel, CSIRVar, CSIRBase, CSIRField};
+
+#endif /* _CSubIR_H_ */
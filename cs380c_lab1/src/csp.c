@@ -795,13 +795,25 @@ static void Compile(char *filename)
 
 int main(int argc, char *argv[])
 {
+  int binary = 0;
+
+  // -binary writes the compact encoding of csir.h instead of text
+  if ((argc >= 2) && (strcmp(argv[1], "-binary") == 0)) {
+    binary = 1;
+    argc--;
+    argv++;
+  }
   CSGInit();
   if (argc >= 2) {
     Compile(argv[1]);
   } else {
     Compile("test.c");
   }
-  CSGDecode();
+  if (binary) {
+    CSGEncode();
+  } else {
+    CSGDecode();
+  }
 
   return 0;
 }
@@ -0,0 +1,21 @@
+#!/usr/bin/env bash
+
+# Size and load time of the text IR and of the binary IR ("csc -binary").
+
+C_SUBSET_COMPILER=${C_SUBSET_COMPILER:-../../cs380c_lab1/src/csc}
+THREE_ADDR_TO_C_TRANSLATOR=${THREE_ADDR_TO_C_TRANSLATOR:-../lab2/build/lab2}
+
+FUNCS=${1:-2000}
+STMTS=${2:-20}
+
+./gen-large.sh ${FUNCS} ${STMTS} > bench-binary.c
+${C_SUBSET_COMPILER} bench-binary.c > bench-binary.3addr 2>/dev/null
+${C_SUBSET_COMPILER} -binary bench-binary.c > bench-binary.csir 2>/dev/null
+echo "input: `grep -c instr bench-binary.3addr` instructions"
+
+for IR in bench-binary.3addr bench-binary.csir
+do
+    MS=`${THREE_ADDR_TO_C_TRANSLATOR} -time < ${IR} 2>&1 >/dev/null | awk '/^parse:/ {print $2}'`
+    echo "${IR##*.}: `wc -c < ${IR}` bytes, parse ${MS} ms"
+done
+rm -f bench-binary.c bench-binary.3addr bench-binary.csir
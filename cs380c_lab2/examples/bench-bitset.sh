@@ -0,0 +1,22 @@
+#!/usr/bin/env bash
+
+# Time per call of the dataflow bit set kernels (scalar, avx2, avx512 as the
+# CPU allows) on sets of 64 bits to 1M bits, then lab2 -opt=scp,dse on a large
+# program with each kernel version.
+
+BENCH_BITSET=${BENCH_BITSET:-../lab2/build/bench-bitset}
+C_SUBSET_COMPILER=${C_SUBSET_COMPILER:-../../cs380c_lab1/src/csc}
+THREE_ADDR_TO_C_TRANSLATOR=${THREE_ADDR_TO_C_TRANSLATOR:-../lab2/build/lab2}
+
+${BENCH_BITSET} ${@:-64 1024 16384 262144 1048576}
+
+./gen-large.sh 1 2000 > bench-bitset.c
+${C_SUBSET_COMPILER} bench-bitset.c > bench-bitset.3addr 2>/dev/null
+echo "-opt=scp,dse on `grep -c instr bench-bitset.3addr` instructions"
+for KERNELS in scalar avx2 avx512
+do
+    ${THREE_ADDR_TO_C_TRANSLATOR} -time -bitset=${KERNELS} -opt=scp,dse < bench-bitset.3addr 2>&1 >/dev/null | awk -v k=${KERNELS} '
+        /^optimize:/ { printf "  %s: optimize %.0f ms\n", k, $2 }
+        /not available/ { printf "  %s: not available\n", k }'
+done
+rm -f bench-bitset.c bench-bitset.3addr
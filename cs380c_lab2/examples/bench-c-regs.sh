@@ -0,0 +1,38 @@
+#!/usr/bin/env bash
+
+# Run time of the C output of every example, compiled with gcc ${CFLAGS},
+# over RUNS runs. The virtual registers are function locals sharing slots
+# by liveness; set BASELINE to another lab2 binary, e.g. one emitting the
+# global REG array, to compare against it. The outputs are checked to match.
+
+C_SUBSET_COMPILER=${C_SUBSET_COMPILER:-../../cs380c_lab1/src/csc}
+THREE_ADDR_TO_C_TRANSLATOR=${THREE_ADDR_TO_C_TRANSLATOR:-../lab2/build/lab2}
+CFLAGS=${CFLAGS:--O2}
+RUNS=${RUNS:-200}
+
+for PROGRAM in ${@:-*.c}
+do
+    BASENAME=`basename ${PROGRAM} .c`
+    ${C_SUBSET_COMPILER} ${PROGRAM} > bench-c-regs.3addr 2>/dev/null
+    echo "${BASENAME}:"
+    for RUN in ${THREE_ADDR_TO_C_TRANSLATOR} ${BASELINE}
+    do
+        ${RUN} -opt=scp,dse -backend=c < bench-c-regs.3addr > bench-c-regs.c
+        gcc -w ${CFLAGS} bench-c-regs.c -o bench-c-regs.bin
+        ./bench-c-regs.bin < /dev/null > bench-c-regs.out
+        if [ ${RUN} = ${THREE_ADDR_TO_C_TRANSLATOR} ]
+        then
+            mv bench-c-regs.out bench-c-regs.expect
+        else
+            cmp -s bench-c-regs.out bench-c-regs.expect || echo "  ${RUN}: output differs"
+        fi
+        START=`date +%s%N`
+        for ((I = 0; I < RUNS; I++))
+        do
+            ./bench-c-regs.bin < /dev/null > /dev/null
+        done
+        END=`date +%s%N`
+        echo "  ${RUN}: $(( (END - START) / RUNS / 1000 )) us/run"
+    done
+done
+rm -f bench-c-regs.3addr bench-c-regs.c bench-c-regs.bin bench-c-regs.out bench-c-regs.expect
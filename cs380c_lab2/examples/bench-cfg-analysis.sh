@@ -0,0 +1,22 @@
+#!/usr/bin/env bash
+
+# Time of the CFG analyses (dominators, post-dominators, dominance frontiers
+# and the loop forest) on one function of growing size: the emit time of
+# -backend=cfg-analysis minus that of -backend=cfg. Near-linear analyses keep
+# the time per block flat as the CFG doubles.
+
+C_SUBSET_COMPILER=${C_SUBSET_COMPILER:-../../cs380c_lab1/src/csc}
+THREE_ADDR_TO_C_TRANSLATOR=${THREE_ADDR_TO_C_TRANSLATOR:-../lab2/build/lab2}
+
+DEPTH=${1:-4}
+for UNITS in 700 1400 2800 5600 11200
+do
+    ./gen-cfg.sh ${UNITS} ${DEPTH} > bench-cfg-analysis.c
+    ${C_SUBSET_COMPILER} bench-cfg-analysis.c > bench-cfg-analysis.3addr 2>/dev/null
+    BLOCKS=`${THREE_ADDR_TO_C_TRANSLATOR} -backend=cfg < bench-cfg-analysis.3addr | awk '/^Basic blocks:/ { n += NF - 2 } END { print n }'`
+    CFG=`${THREE_ADDR_TO_C_TRANSLATOR} -time -backend=cfg < bench-cfg-analysis.3addr 2>&1 >/dev/null | awk '/^emit:/ { print $2 }'`
+    ANALYSIS=`${THREE_ADDR_TO_C_TRANSLATOR} -time -backend=cfg-analysis < bench-cfg-analysis.3addr 2>&1 >/dev/null | awk '/^emit:/ { print $2 }'`
+    awk -v blocks=${BLOCKS} -v cfg=${CFG} -v analysis=${ANALYSIS} '
+        BEGIN { printf "%7d blocks: analyses %.0f ms, %.2f us per block\n", blocks, analysis - cfg, (analysis - cfg) * 1000 / blocks }'
+done
+rm -f bench-cfg-analysis.c bench-cfg-analysis.3addr
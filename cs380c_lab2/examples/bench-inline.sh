@@ -0,0 +1,38 @@
+#!/usr/bin/env bash
+
+# Dynamic instruction counts of every example, optimized with ${OPT},
+# without and with inline first. Each statement of the C translation is one
+# instruction, so a counter bumped before every statement counts those run,
+# except for a call, which stands for its params, the call itself and the
+# enter and ret of the callee. The outputs are checked to match.
+
+C_SUBSET_COMPILER=${C_SUBSET_COMPILER:-../../cs380c_lab1/src/csc}
+THREE_ADDR_TO_C_TRANSLATOR=${THREE_ADDR_TO_C_TRANSLATOR:-../lab2/build/lab2}
+OPT=${OPT:-scp,dse}
+
+for PROGRAM in ${@:-*.c}
+do
+    BASENAME=`basename ${PROGRAM} .c`
+    ${C_SUBSET_COMPILER} ${PROGRAM} > bench-inline.3addr 2>/dev/null
+    echo "${BASENAME}:"
+    for PASSES in ${OPT} inline,${OPT}
+    do
+        ${THREE_ADDR_TO_C_TRANSLATOR} -opt=${PASSES} -backend=c < bench-inline.3addr | sed \
+            -e 's/^#include <stdio.h>/&\n#include <stdlib.h>/' \
+            -e '/^#define ReadLong/a long executed;\nvoid report(void) { fprintf(stderr, "%lld\\n", executed); }' \
+            -e 's/^void main(){/&\n  atexit(report);/' \
+            -e '/^  long /b' \
+            -e 's/^  \(inst_[0-9]*:\)\{0,1\}\(function_[0-9]*(\(.*\)); *\)$/  \1executed += 3 + sizeof((long[]){\3}) \/ sizeof(long); \2/;t' \
+            -e 's/^  \(inst_[0-9]*:\)\{0,1\}\(.*; *\)$/  \1executed++; \2/' > bench-inline.c
+        gcc -w bench-inline.c -o bench-inline.bin
+        ./bench-inline.bin < /dev/null > bench-inline.out 2> bench-inline.count
+        if [ ${PASSES} = ${OPT} ]
+        then
+            mv bench-inline.out bench-inline.expect
+        else
+            cmp -s bench-inline.out bench-inline.expect || echo "  ${PASSES}: output differs"
+        fi
+        echo "  ${PASSES}: `cat bench-inline.count` instructions"
+    done
+done
+rm -f bench-inline.3addr bench-inline.c bench-inline.bin bench-inline.out bench-inline.expect bench-inline.count
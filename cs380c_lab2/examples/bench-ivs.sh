@@ -0,0 +1,36 @@
+#!/usr/bin/env bash
+
+# Dynamic instruction counts of every example, optimized with ${OPT} and
+# dse, without and with ivs. Each statement of the C translation is one
+# instruction, so a counter bumped before every statement counts those run.
+# The outputs are checked to match.
+
+C_SUBSET_COMPILER=${C_SUBSET_COMPILER:-../../cs380c_lab1/src/csc}
+THREE_ADDR_TO_C_TRANSLATOR=${THREE_ADDR_TO_C_TRANSLATOR:-../lab2/build/lab2}
+OPT=${OPT:-scp,gvn,licm}
+
+for PROGRAM in ${@:-*.c}
+do
+    BASENAME=`basename ${PROGRAM} .c`
+    ${C_SUBSET_COMPILER} ${PROGRAM} > bench-ivs.3addr 2>/dev/null
+    echo "${BASENAME}:"
+    for PASSES in ${OPT},dse ${OPT},ivs,dse
+    do
+        ${THREE_ADDR_TO_C_TRANSLATOR} -opt=${PASSES} -backend=c < bench-ivs.3addr | sed \
+            -e 's/^#include <stdio.h>/&\n#include <stdlib.h>/' \
+            -e '/^#define ReadLong/a long executed;\nvoid report(void) { fprintf(stderr, "%lld\\n", executed); }' \
+            -e 's/^void main(){/&\n  atexit(report);/' \
+            -e '/^  long /b' \
+            -e 's/^  \(inst_[0-9]*:\)\{0,1\}\(.*; *\)$/  \1executed++; \2/' > bench-ivs.c
+        gcc -w bench-ivs.c -o bench-ivs.bin
+        ./bench-ivs.bin < /dev/null > bench-ivs.out 2> bench-ivs.count
+        if [ ${PASSES} = ${OPT},dse ]
+        then
+            mv bench-ivs.out bench-ivs.expect
+        else
+            cmp -s bench-ivs.out bench-ivs.expect || echo "  ${PASSES}: output differs"
+        fi
+        echo "  ${PASSES}: `cat bench-ivs.count` instructions"
+    done
+done
+rm -f bench-ivs.3addr bench-ivs.c bench-ivs.bin bench-ivs.out bench-ivs.expect bench-ivs.count
@@ -0,0 +1,23 @@
+#!/usr/bin/env bash
+
+# Parse and build time of a large program on 1, 2, 4 ... up to nproc threads.
+
+C_SUBSET_COMPILER=${C_SUBSET_COMPILER:-../../cs380c_lab1/src/csc}
+THREE_ADDR_TO_C_TRANSLATOR=${THREE_ADDR_TO_C_TRANSLATOR:-../lab2/build/lab2}
+
+FUNCS=${1:-2000}
+STMTS=${2:-20}
+
+./gen-large.sh ${FUNCS} ${STMTS} > bench-jobs.c
+${C_SUBSET_COMPILER} bench-jobs.c > bench-jobs.3addr 2>/dev/null
+echo "input: `grep -c instr bench-jobs.3addr` instructions, `nproc` cores"
+
+JOBS=1
+while [ ${JOBS} -le `nproc` ]
+do
+    ${THREE_ADDR_TO_C_TRANSLATOR} -time -jobs=${JOBS} < bench-jobs.3addr 2>&1 >/dev/null | awk -v jobs=${JOBS} '
+        /^parse:/ { parse = $2 } /^build:/ { build = $2 }
+        END { printf "-jobs=%d: parse %.0f ms, build %.0f ms\n", jobs, parse, build }'
+    JOBS=$((JOBS * 2))
+done
+rm -f bench-jobs.c bench-jobs.3addr
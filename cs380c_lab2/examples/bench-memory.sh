@@ -0,0 +1,27 @@
+#!/usr/bin/env bash
+
+# Peak RSS of building the IR for regslarge.c with its loop body repeated
+# SCALE times, with the default heap allocation and with -arena.
+# Set BASELINE to another lab2 binary to compare against it.
+
+C_SUBSET_COMPILER=${C_SUBSET_COMPILER:-../../cs380c_lab1/src/csc}
+THREE_ADDR_TO_C_TRANSLATOR=${THREE_ADDR_TO_C_TRANSLATOR:-../lab2/build/lab2}
+
+for SCALE in ${@:-1 4 16 64}
+do
+    # repeat the statements between "while (a < 4) {" and "WriteLine();"
+    awk -v n=${SCALE} '
+        /while \(a < 4\)/ { print; body = 1; next }
+        body && /WriteLine\(\);/ { for (i = 0; i < n; i++) printf "%s", lines; body = 0 }
+        body { lines = lines $0 "\n"; next }
+        { print }' regslarge.c > bench-memory.c
+    ${C_SUBSET_COMPILER} bench-memory.c > bench-memory.3addr 2>/dev/null
+    echo "scale ${SCALE}: `grep -c instr bench-memory.3addr` instructions"
+    for RUN in "${THREE_ADDR_TO_C_TRANSLATOR}" "${THREE_ADDR_TO_C_TRANSLATOR} -arena" ${BASELINE}
+    do
+        ${RUN} -time < bench-memory.3addr 2>&1 | awk -v run="${RUN}" '
+            /^build:/ { ms = $2 } /^peak rss:/ { kb = $3 }
+            END { printf "  %s: build %s ms, peak rss %s KB\n", run, ms, kb }'
+    done
+done
+rm -f bench-memory.c bench-memory.3addr
@@ -0,0 +1,27 @@
+#!/usr/bin/env bash
+
+# scp, dse and C emission time of a large program on 1, 2, 4 ... up to nproc
+# threads, one function per task. The output is checked to be the same.
+
+C_SUBSET_COMPILER=${C_SUBSET_COMPILER:-../../cs380c_lab1/src/csc}
+THREE_ADDR_TO_C_TRANSLATOR=${THREE_ADDR_TO_C_TRANSLATOR:-../lab2/build/lab2}
+
+FUNCS=${1:-2000}
+STMTS=${2:-20}
+
+./gen-large.sh ${FUNCS} ${STMTS} > bench-opt-jobs.c
+${C_SUBSET_COMPILER} bench-opt-jobs.c > bench-opt-jobs.3addr 2>/dev/null
+echo "input: `grep -c instr bench-opt-jobs.3addr` instructions, `nproc` cores"
+
+${THREE_ADDR_TO_C_TRANSLATOR} -opt=scp,dse -backend=c < bench-opt-jobs.3addr > bench-opt-jobs.expect
+JOBS=1
+while [ ${JOBS} -le `nproc` ]
+do
+    ${THREE_ADDR_TO_C_TRANSLATOR} -time --jobs ${JOBS} -opt=scp,dse -backend=c < bench-opt-jobs.3addr 2>bench-opt-jobs.time >bench-opt-jobs.out
+    cmp -s bench-opt-jobs.out bench-opt-jobs.expect || echo "--jobs ${JOBS}: output differs"
+    awk -v jobs=${JOBS} '
+        /^optimize:/ { opt = $2 } /^emit:/ { emit = $2 }
+        END { printf "--jobs %d: optimize %.0f ms, emit %.0f ms\n", jobs, opt, emit }' bench-opt-jobs.time
+    JOBS=$((JOBS * 2))
+done
+rm -f bench-opt-jobs.c bench-opt-jobs.3addr bench-opt-jobs.expect bench-opt-jobs.out bench-opt-jobs.time
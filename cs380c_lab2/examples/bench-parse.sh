@@ -0,0 +1,23 @@
+#!/usr/bin/env bash
+
+# Parse throughput of the line-by-line reader and the single-pass tokenizer.
+# Build lab2 with optimization first, e.g.
+#   cmake -S ../lab2 -B ../lab2/build -DCMAKE_BUILD_TYPE=Release
+
+C_SUBSET_COMPILER=${C_SUBSET_COMPILER:-../../cs380c_lab1/src/csc}
+THREE_ADDR_TO_C_TRANSLATOR=${THREE_ADDR_TO_C_TRANSLATOR:-../lab2/build/lab2}
+
+FUNCS=${1:-2000}
+STMTS=${2:-20}
+
+./gen-large.sh ${FUNCS} ${STMTS} > bench-parse.c
+${C_SUBSET_COMPILER} bench-parse.c > bench-parse.3addr 2>/dev/null
+BYTES=`wc -c < bench-parse.3addr`
+echo "input: ${BYTES} bytes, `grep -c instr bench-parse.3addr` instructions"
+
+for PARSER in -parser=getline -parser=tokenizer
+do
+    MS=`${THREE_ADDR_TO_C_TRANSLATOR} -time ${PARSER} < bench-parse.3addr 2>&1 | awk '/^parse:/ {print $2}'`
+    echo "${PARSER}: ${MS} ms, `awk -v b=${BYTES} -v ms=${MS} 'BEGIN {printf "%.1f", b / ms / 1000}'` MB/s"
+done
+rm -f bench-parse.c bench-parse.3addr
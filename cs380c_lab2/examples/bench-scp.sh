@@ -0,0 +1,22 @@
+#!/usr/bin/env bash
+
+# scp time on a single function of growing length. With kill sets built from
+# the per-object definition index, the time per instruction stays flat.
+# Set BASELINE to another lab2 binary to compare against it.
+
+C_SUBSET_COMPILER=${C_SUBSET_COMPILER:-../../cs380c_lab1/src/csc}
+THREE_ADDR_TO_C_TRANSLATOR=${THREE_ADDR_TO_C_TRANSLATOR:-../lab2/build/lab2}
+
+for STMTS in ${@:-250 500 1000 2000}
+do
+    ./gen-large.sh 1 ${STMTS} > bench-scp.c
+    ${C_SUBSET_COMPILER} bench-scp.c > bench-scp.3addr 2>/dev/null
+    INSTRS=`grep -c instr bench-scp.3addr`
+    echo "${STMTS} statement pairs: ${INSTRS} instructions"
+    for RUN in ${THREE_ADDR_TO_C_TRANSLATOR} ${BASELINE}
+    do
+        ${RUN} -time -opt=scp < bench-scp.3addr 2>&1 >/dev/null | awk -v run=${RUN} -v n=${INSTRS} '
+            /^optimize:/ { printf "  %s: scp %.0f ms, %.2f us/instruction\n", run, $2, $2 * 1000 / n }'
+    done
+done
+rm -f bench-scp.c bench-scp.3addr
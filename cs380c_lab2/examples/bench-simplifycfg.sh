@@ -0,0 +1,24 @@
+#!/usr/bin/env bash
+
+# Basic blocks and dataflow iterations of every example, optimized with
+# ${OPT} and dse, without and with simplifycfg between them. The blocks are
+# counted after the last pass; the iterations are those of all the passes.
+
+C_SUBSET_COMPILER=${C_SUBSET_COMPILER:-../../cs380c_lab1/src/csc}
+THREE_ADDR_TO_C_TRANSLATOR=${THREE_ADDR_TO_C_TRANSLATOR:-../lab2/build/lab2}
+OPT=${OPT:-scp}
+
+for PROGRAM in ${@:-*.c}
+do
+    BASENAME=`basename ${PROGRAM} .c`
+    ${C_SUBSET_COMPILER} ${PROGRAM} > bench-simplifycfg.3addr 2>/dev/null
+    echo "${BASENAME}:"
+    for PASSES in ${OPT},dse ${OPT},simplifycfg,dse
+    do
+        ${THREE_ADDR_TO_C_TRANSLATOR} -opt=${PASSES} -dataflow-stats -backend=3addr < bench-simplifycfg.3addr 2>&1 >/dev/null | awk -v passes=${PASSES} '
+            /^Basic blocks:/ { blocks += $3 }
+            /^Dataflow iterations:/ { iterations += $3 }
+            END { printf "  %s: %d blocks, %d dataflow iterations\n", passes, blocks, iterations }'
+    done
+done
+rm -f bench-simplifycfg.3addr
@@ -0,0 +1,27 @@
+#!/usr/bin/env bash
+
+# Peak RSS, total time and time to the first output byte of the batch
+# pipeline and of -stream, which emits and frees each function at its ret.
+
+C_SUBSET_COMPILER=${C_SUBSET_COMPILER:-../../cs380c_lab1/src/csc}
+THREE_ADDR_TO_C_TRANSLATOR=${THREE_ADDR_TO_C_TRANSLATOR:-../lab2/build/lab2}
+
+FUNCS=${1:-4000}
+STMTS=${2:-5}
+
+./gen-large.sh ${FUNCS} ${STMTS} > bench-stream.c
+${C_SUBSET_COMPILER} bench-stream.c > bench-stream.3addr 2>/dev/null
+echo "input: `grep -c instr bench-stream.3addr` instructions"
+
+for MODE in "" -stream
+do
+    ARGS="${MODE} -opt=scp,dse -backend=c"
+    STATS=`${THREE_ADDR_TO_C_TRANSLATOR} -time ${ARGS} < bench-stream.3addr 2>&1 >/dev/null | awk '
+        /ms$/ { ms += $2 } /^peak rss:/ { kb = $3 }
+        END { printf "total %.0f ms, peak rss %s KB", ms, kb }'`
+    START=`date +%s%N`
+    ${THREE_ADDR_TO_C_TRANSLATOR} ${ARGS} < bench-stream.3addr | head -c 1 > /dev/null
+    FIRST=$(( (`date +%s%N` - START) / 1000000 ))
+    echo "${MODE:-batch}: ${STATS}, first byte ${FIRST} ms"
+done
+rm -f bench-stream.c bench-stream.3addr
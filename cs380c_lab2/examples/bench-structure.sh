@@ -0,0 +1,49 @@
+#!/usr/bin/env bash
+
+# Run time of every example, optimized with ${OPT} and compiled by gcc -O2,
+# with every branch a goto (-backend=c-goto) and with the loops and ifs
+# recovered (-backend=c). The examples run in well under a millisecond, so
+# main is renamed and called ${REPEAT} times, its output thrown away after
+# the first run, which is checked to match.
+
+C_SUBSET_COMPILER=${C_SUBSET_COMPILER:-../../cs380c_lab1/src/csc}
+THREE_ADDR_TO_C_TRANSLATOR=${THREE_ADDR_TO_C_TRANSLATOR:-../lab2/build/lab2}
+OPT=${OPT:-scp,dse}
+REPEAT=${REPEAT:-2000}
+
+for PROGRAM in ${@:-*.c}
+do
+    BASENAME=`basename ${PROGRAM} .c`
+    ${C_SUBSET_COMPILER} ${PROGRAM} > bench-structure.3addr 2>/dev/null
+    echo "${BASENAME}:"
+    for BACKEND in c-goto c
+    do
+        ${THREE_ADDR_TO_C_TRANSLATOR} -opt=${OPT} -backend=${BACKEND} < bench-structure.3addr | sed \
+            -e 's/^#include <stdio.h>/&\n#include <time.h>/' \
+            -e 's/^void main(){/void run(){/' > bench-structure.c
+        cat >> bench-structure.c <<EOF
+int main() {
+    run();
+    fflush(stdout);
+    freopen("/dev/null", "w", stdout);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < ${REPEAT}; i++)
+        run();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fprintf(stderr, "%.0f", ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / ${REPEAT});
+    return 0;
+}
+EOF
+        gcc -O2 -w bench-structure.c -o bench-structure.bin
+        ./bench-structure.bin < /dev/null > bench-structure.out 2> bench-structure.time
+        if [ ${BACKEND} = c-goto ]
+        then
+            mv bench-structure.out bench-structure.expect
+        else
+            cmp -s bench-structure.out bench-structure.expect || echo "  ${BACKEND}: output differs"
+        fi
+        echo "  ${BACKEND}: `cat bench-structure.time` ns per run"
+    done
+done
+rm -f bench-structure.3addr bench-structure.c bench-structure.bin bench-structure.out bench-structure.expect bench-structure.time
@@ -0,0 +1,38 @@
+#!/usr/bin/env bash
+
+# divzero.c divides by a constant 0 on paths that never run, once in a
+# callee only ever called with 0, which inlining copies into main, and once
+# in main itself. Every -opt list must translate it without folding the
+# division, and the result must print what gcc's build of the source prints.
+# lab3 is checked too when it is built.
+
+C_SUBSET_COMPILER=${C_SUBSET_COMPILER:-../../cs380c_lab1/src/csc}
+THREE_ADDR_TO_C_TRANSLATOR=${THREE_ADDR_TO_C_TRANSLATOR:-../lab2/build/lab2}
+SSA_TRANSLATOR=${SSA_TRANSLATOR:-../../cs380c_lab3/lab3/build/lab3}
+
+${C_SUBSET_COMPILER} divzero.c > check-divzero.3addr 2>/dev/null
+gcc -w divzero.c -o check-divzero.bin
+./check-divzero.bin < /dev/null > check-divzero.expect
+
+check() {
+    if ! "$@" -backend=c < check-divzero.3addr > check-divzero.c; then
+        echo "$*: translation failed"
+        return
+    fi
+    gcc -w check-divzero.c -o check-divzero.bin
+    ./check-divzero.bin < /dev/null > check-divzero.out
+    cmp -s check-divzero.out check-divzero.expect && echo "$*: ok" || echo "$*: output differs"
+}
+
+for PASSES in scp scp,dse ipcp ipcp,dse inline,scp inline,scp,dse inline,ipcp,simplifycfg,gvn,licm,ivs,dse
+do
+    check ${THREE_ADDR_TO_C_TRANSLATOR} -opt=${PASSES}
+done
+if [ -x ${SSA_TRANSLATOR} ]
+then
+    for PASSES in scp scp,dse
+    do
+        check ${SSA_TRANSLATOR} -opt=${PASSES}
+    done
+fi
+rm -f check-divzero.3addr check-divzero.c check-divzero.bin check-divzero.out check-divzero.expect
@@ -0,0 +1,45 @@
+#include <stdio.h>
+#define WriteLine() printf("\n");
+#define WriteLong(x) printf(" %lld", (long)x);
+#define ReadLong(a) if (fscanf(stdin, "%lld", &a) != 1) a = 0;
+#define long long long
+
+
+long x;
+
+
+/* Only ever called with 0, so a constant propagated into it meets a
+   division by zero on a path that never runs. */
+void F(long d)
+{
+  x = 7;
+  if (d > 0) {
+    x = 100 / d;
+  }
+  WriteLong(x);
+  WriteLine();
+}
+
+
+void main()
+{
+  long d;
+  long y;
+
+  F(0);
+
+  d = 0;
+  ReadLong(y);
+  if (y == 1) {
+    y = 100 / d;
+  }
+  WriteLong(y);
+  WriteLine();
+}
+
+
+/*
+ expected output, with nothing on the input:
+ 7
+ 0
+*/
@@ -0,0 +1,45 @@
+#!/usr/bin/env bash
+
+# Emit a synthetic C-subset program whose main is one large CFG for
+# bench-cfg-analysis.sh: UNITS loop nests, each DEPTH loops deep with a
+# branch in every loop, about 3 * DEPTH basic blocks per unit.
+
+[ $# -ne 2 ] && { echo "Usage $0 UNITS DEPTH" >&2; exit 1; }
+
+UNITS=$1
+DEPTH=$2
+
+cat <<'HEADER'
+#include <stdio.h>
+#define WriteLine() printf("\n");
+#define WriteLong(x) printf(" %lld", (long)x);
+#define ReadLong(a) if (fscanf(stdin, "%lld", &a) != 1) a = 0;
+#define long long long
+
+HEADER
+
+echo "void main()"
+echo "{"
+echo -n "  long s"
+for ((d = 0; d < DEPTH; d++)); do
+    echo -n ", i$d"
+done
+echo ";"
+echo
+echo "  s = 0;"
+for ((u = 0; u < UNITS; u++)); do
+    for ((d = 0; d < DEPTH; d++)); do
+        echo "  i$d = 0;"
+        echo "  while (i$d < 2) {"
+        echo "    if (s < $u) {"
+        echo "      s = s + $d;"
+        echo "    }"
+    done
+    for ((d = DEPTH - 1; d >= 0; d--)); do
+        echo "    i$d = i$d + 1;"
+        echo "  }"
+    done
+done
+echo "  WriteLong(s);"
+echo "  WriteLine();"
+echo "}"
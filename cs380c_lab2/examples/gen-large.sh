@@ -0,0 +1,55 @@
+#!/usr/bin/env bash
+
+# Emit a synthetic C-subset program for the benchmark scripts:
+# FUNCS functions, each running a loop with STMTS statements in its body.
+
+[ $# -ne 2 ] && { echo "Usage $0 FUNCS STMTS" >&2; exit 1; }
+
+FUNCS=$1
+STMTS=$2
+
+cat <<'HEADER'
+#include <stdio.h>
+#define WriteLine() printf("\n");
+#define WriteLong(x) printf(" %lld", (long)x);
+#define ReadLong(a) if (fscanf(stdin, "%lld", &a) != 1) a = 0;
+#define long long long
+
+long g;
+HEADER
+
+for ((f = 0; f < FUNCS; f++)); do
+    echo
+    echo "void f$f(long p)"
+    echo "{"
+    echo "  long i, s, t;"
+    echo "  long v[8];"
+    echo
+    echo "  i = 0;"
+    echo "  s = p;"
+    echo "  t = 1;"
+    echo "  while (i < 8) {"
+    echo "    v[i] = s * 3 + i;"
+    for ((k = 0; k < STMTS; k++)); do
+        echo "    t = t + (s - $k) % 7;"
+        echo "    s = s + v[i] % (t * t + $((k + 2)));"
+    done
+    echo "    i = i + 1;"
+    echo "  }"
+    echo "  if (s < 0) {"
+    echo "    s = 0 - s;"
+    echo "  }"
+    echo "  g = g + s % 1000;"
+    echo "}"
+done
+
+echo
+echo "void main()"
+echo "{"
+echo "  g = 0;"
+for ((f = 0; f < FUNCS; f++)); do
+    echo "  f$f($f);"
+done
+echo "  WriteLong(g);"
+echo "  WriteLine();"
+echo "}"
@@ -0,0 +1,31 @@
+#ifndef BITSET_H
+#define BITSET_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Word-wise kernels over packed bit sets of n 64-bit words, the inner loops
+// of the dataflow solver. There is a scalar, an AVX2 and an AVX-512 version;
+// the best one the CPU supports is chosen at startup with cpuid.
+struct BitsetKernels {
+    const char* name;
+    // dst |= src
+    void (*or_into)(uint64_t* dst, const uint64_t* src, size_t n);
+    // dst &= src
+    void (*and_into)(uint64_t* dst, const uint64_t* src, size_t n);
+    // dst &= ~src
+    void (*andnot_into)(uint64_t* dst, const uint64_t* src, size_t n);
+    // a == b, returning at the first differing block
+    bool (*equal)(const uint64_t* a, const uint64_t* b, size_t n);
+    // dst = gen | (x & ~kill), returning whether dst changed
+    bool (*transfer)(uint64_t* dst, const uint64_t* gen, const uint64_t* x, const uint64_t* kill, size_t n);
+};
+
+// The kernels in use
+extern const BitsetKernels* bitset_kernels;
+// Every version this CPU can run, scalar first
+std::vector<const BitsetKernels*> available_bitset_kernels();
+// Use the version called name instead (-bitset=scalar|avx2|avx512); false if it is not available
+bool select_bitset_kernels(const std::string& name);
+#endif  //BITSET_H
@@ -0,0 +1,24 @@
+#ifndef CALL_GRAPH_H
+#define CALL_GRAPH_H
+#include "ir.h"
+
+// The call graph of a program, from the call [id] operands, and its strongly
+// connected components. Functions are indexed as in Program::functions.
+class CallGraph {
+   public:
+    vector<vector<int>> callees;  // per function, the functions it calls, sorted and unique
+    vector<vector<int>> callers;  // per function, the functions calling it, likewise
+    vector<char> calls_unknown;   // per function, whether it calls an id that is no function
+    vector<int> scc_of;           // per function, the index of its SCC
+    // The SCCs in bottom-up order: every SCC comes after the SCCs it calls
+    vector<vector<int>> sccs;
+    vector<char> is_recursive;  // per SCC, whether it has a cycle (a function calling itself included)
+    // The SCCs grouped by height (the longest chain of calls out of them) and
+    // by depth (the longest chain of calls into them). The SCCs of one group
+    // never call each other, so a bottom-up pass can run each group of
+    // by_height in parallel and a top-down pass each group of by_depth
+    vector<vector<int>> by_height, by_depth;
+
+    explicit CallGraph(const vector<Function>& functions);
+};
+#endif  //CALL_GRAPH_H
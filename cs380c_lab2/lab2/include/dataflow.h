@@ -0,0 +1,169 @@
+#ifndef DATAFLOW_H
+#define DATAFLOW_H
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "bitset.h"
+#include "ir.h"
+
+// A fixed-size set of small integers (definition or variable indices),
+// packed 64 to a word. The bulk operations run on bitset_kernels
+class BitVector {
+   private:
+    vector<uint64_t> words;
+    size_t bits;
+
+   public:
+    BitVector() : bits(0){};
+    explicit BitVector(size_t n, bool value = false) : words((n + 63) / 64, value ? ~0ull : 0ull), bits(n) {
+        if (value && n % 64 != 0)
+            words.back() &= (1ull << (n % 64)) - 1;
+    }
+    size_t size() const { return bits; }
+    bool test(size_t i) const { return words[i / 64] >> (i % 64) & 1; }
+    void set(size_t i) { words[i / 64] |= 1ull << (i % 64); }
+    void reset(size_t i) { words[i / 64] &= ~(1ull << (i % 64)); }
+    void clear() { std::fill(words.begin(), words.end(), 0ull); }
+    bool any() const {
+        for (auto w : words)
+            if (w != 0)
+                return true;
+        return false;
+    }
+    BitVector& operator|=(const BitVector& o) {
+        bitset_kernels->or_into(words.data(), o.words.data(), words.size());
+        return *this;
+    }
+    BitVector& operator&=(const BitVector& o) {
+        bitset_kernels->and_into(words.data(), o.words.data(), words.size());
+        return *this;
+    }
+    // this = this - o
+    BitVector& subtract(const BitVector& o) {
+        bitset_kernels->andnot_into(words.data(), o.words.data(), words.size());
+        return *this;
+    }
+    bool operator==(const BitVector& o) const {
+        return bits == o.bits && bitset_kernels->equal(words.data(), o.words.data(), words.size());
+    }
+    bool operator!=(const BitVector& o) const { return !(*this == o); }
+    // this = gen | (x - kill), the gen/kill transfer; returns whether this changed
+    bool assign_transfer(const BitVector& gen, const BitVector& x, const BitVector& kill) {
+        return bitset_kernels->transfer(words.data(), gen.words.data(), x.words.data(), kill.words.data(), words.size());
+    }
+    // Call f on every member, in increasing order
+    template <typename F>
+    void for_each(F f) const {
+        for (size_t i = 0; i < words.size(); i++) {
+            for (auto w = words[i]; w != 0; w &= w - 1)
+                f(i * 64 + __builtin_ctzll(w));
+        }
+    }
+};
+
+enum class Direction { FORWARD, BACKWARD };
+enum class Meet { UNION, INTERSECTION };
+
+// The classic transfer out = gen | (in - kill), one gen and kill set per block
+// (for a backward problem read in = gen | (out - kill))
+struct GenKill {
+    const vector<BitVector>& gens;
+    const vector<BitVector>& kills;
+    bool operator()(size_t b, const BitVector& x, BitVector& y) const {
+        return y.assign_transfer(gens[b], x, kills[b]);
+    }
+};
+
+// The blocks of a function in reverse postorder of a depth-first walk from
+// the entry along successor edges; unreachable blocks follow in layout order
+vector<int> reverse_postorder(const Function& func);
+
+// The solution of a dataflow problem over the basic blocks of a function,
+// indexed as Function::basic_blocks
+struct DataflowResult {
+    vector<BitVector> ins, outs;
+    int iterations = 0;  // blocks taken off the worklist until nothing changed
+};
+
+// Solve a dataflow problem over sets of width bits.
+// FORWARD: in[b] is the meet of out[p] over the predecessors p of b, and
+// out[b] = transfer(b, in[b]). BACKWARD: out[b] is the meet of in[s] over the
+// successors s, and in[b] = transfer(b, out[b]). transfer(b, x, y) stores its
+// result in y and returns whether y changed. With INTERSECTION, every set but
+// the boundary (the entry's in or the exits' out) starts full. The boundary
+// is empty, or *boundary when given, e.g. facts known on entry to the function.
+// The worklist always yields the queued block that comes first in reverse
+// postorder (postorder for BACKWARD), so each pass over a loop sees its
+// inputs already updated and loops settle in a few passes.
+template <Direction dir, Meet meet, typename Transfer>
+DataflowResult solve_dataflow(const Function& func, size_t width, Transfer transfer, const BitVector* boundary = nullptr) {
+    const auto bb_cnt = func.basic_blocks.size();
+    // the edges the meet reads from and the blocks to revisit on a change, as block indices
+    vector<vector<int>> sources(bb_cnt), sinks(bb_cnt);
+    for (size_t b = 0; b < bb_cnt; b++) {
+        for (auto label : func.basic_blocks[b].successor_labels) {
+            auto s = func.idx_of_bb.at(label);
+            if (dir == Direction::FORWARD) {
+                sources[s].push_back(b);
+                sinks[b].push_back(s);
+            } else {
+                sources[b].push_back(s);
+                sinks[s].push_back(b);
+            }
+        }
+    }
+    // rank: the priority of each block, lowest first
+    auto order = reverse_postorder(func);
+    if (dir == Direction::BACKWARD)
+        std::reverse(order.begin(), order.end());
+    vector<int> rank(bb_cnt);
+    for (size_t r = 0; r < bb_cnt; r++)
+        rank[order[r]] = r;
+
+    DataflowResult res;
+    const bool full = meet == Meet::INTERSECTION;
+    res.ins.assign(bb_cnt, BitVector(width, full));
+    res.outs.assign(bb_cnt, BitVector(width, full));
+    auto& meets = dir == Direction::FORWARD ? res.ins : res.outs;
+    auto& results = dir == Direction::FORWARD ? res.outs : res.ins;
+
+    // the worklist holds ranks; in_queue keeps every block in it at most once
+    std::priority_queue<int, vector<int>, std::greater<int>> worklist;
+    vector<char> in_queue(bb_cnt, true);
+    for (size_t r = 0; r < bb_cnt; r++)
+        worklist.push(r);
+    while (!worklist.empty()) {
+        auto b = order[worklist.top()];
+        worklist.pop();
+        in_queue[b] = false;
+        res.iterations++;
+        auto& m = meets[b];
+        if (sources[b].empty()) {
+            if (boundary)
+                m = *boundary;
+            else
+                m.clear();
+        } else {
+            m = results[sources[b][0]];
+            for (size_t i = 1; i < sources[b].size(); i++) {
+                if (meet == Meet::UNION)
+                    m |= results[sources[b][i]];
+                else
+                    m &= results[sources[b][i]];
+            }
+        }
+        if (!transfer(b, m, results[b]))
+            continue;
+        for (auto s : sinks[b]) {
+            if (!in_queue[s]) {
+                in_queue[s] = true;
+                worklist.push(rank[s]);
+            }
+        }
+    }
+    return res;
+}
+#endif  //DATAFLOW_H
@@ -2,20 +2,30 @@
 #define IR_H
 #include <array>
 #include <cassert>
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <optional>
 #include <queue>
 #include <set>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
+
+#include "csir.h"
 using std::array;
 using std::deque;
 using std::map;
 using std::set;
 using std::string;
+using std::string_view;
 using std::unordered_map;
 using std::unordered_set;
 using std::vector;
@@ -25,9 +35,72 @@ using std::vector;
 //#define FUNCTION_DEBUG
 //#define BASIC_LEADER_DEBUG
 
+// Dense 32-bit IDs for every named object and virtual register of a Program.
+// A variable is identified by its name and offset, so x#-8 and x_base#-8 share an ID
+class SymbolTable {
+   public:
+    enum Space : unsigned char {
+        STORAGE,   // local variables, parameters and globals
+        FIELD,     // struct field offsets
+        REGISTER,  // virtual registers, identified by the label of their instruction
+    };
+    static constexpr uint32_t NONE = UINT32_MAX;
+    SymbolTable() { intern_name(""); }  // name 0 is the empty name of registers
+    // names are handed out as views into the table, so it can be moved but not copied
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+    SymbolTable(SymbolTable&&) = default;
+    SymbolTable& operator=(SymbolTable&&) = default;
+
+    uint32_t intern(string_view name, long long offset, Space space);
+    // Intern the name alone, for callers that pair one name with many offsets
+    uint32_t intern_name(string_view name);
+    uint32_t intern(uint32_t name_id, long long offset, Space space);
+    uint32_t intern_reg(long long label) { return intern(0, label, REGISTER); }
+    // Intern every symbol of other in the order other handed out its ids, and
+    // return the id each one gets here. Merging the tables of consecutive
+    // chunks in order gives the ids a single table would have given.
+    vector<uint32_t> merge(const SymbolTable& other);
+    const string& name(uint32_t id) const { return names[entries[id].name]; }
+    uint32_t size() const { return entries.size(); }
+
+   private:
+    struct Key {
+        uint32_t name;
+        long long offset;
+        Space space;
+        bool operator==(const Key& k) const {
+            return name == k.name && offset == k.offset && space == k.space;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const {
+            return std::hash<long long>()(k.offset * 31 + k.space) ^ (size_t(k.name) * 0x9e3779b97f4a7c15ull);
+        }
+    };
+    deque<string> names;  // deque: interning never moves the strings name_ids points into
+    unordered_map<string_view, uint32_t> name_ids;
+    vector<Key> entries;
+    unordered_map<Key, uint32_t, KeyHash> ids;  // STORAGE and FIELD symbols
+    vector<uint32_t> reg_ids;                   // REGISTER symbols, indexed by label - reg_base
+    long long reg_base = 0;
+};
+
+// The C locals holding the virtual registers of one function, as
+// Function::allocate_registers assigns them: register (label) lives in
+// prefix + slot_of[label - label_0], and registers never live at the same
+// time may share a slot
+struct RegisterSlots {
+    string prefix = "t";
+    long long label_0 = 0;
+    vector<int> slot_of;
+    int slot_cnt = 0;
+    string name(long long label) const { return prefix + std::to_string(slot_of[label - label_0]); }
+};
+
 class Operand {
    public:
-    enum Type {
+    enum Type : unsigned char {
         INVALID,
         GP,
         FP,
@@ -45,7 +118,9 @@ class Operand {
         END
     };
 
+    // 16 bytes and trivially copyable: type, symbol and one 8-byte payload
     Type type;
+    uint32_t symbol;  // variables, fields and registers, SymbolTable::NONE otherwise
     union {
         long long constant;    // 19.Constants: For example, 24
         long long offset;      // 20.Address offsets 21.Field offsets 22.Local variables (scalars) offsets
@@ -53,15 +128,17 @@ class Operand {
         long long inst_label;  // 24.Instruction labels
         long long function_id;
     };
-    string variable_name;
     static map<Operand::Type, string> type_name;
-    Operand() : type(Operand::Type::INVALID){};
+    Operand() : type(Operand::Type::INVALID), symbol(SymbolTable::NONE){};
 
-    string ccode() const;
-    string icode() const;
+    string ccode(const SymbolTable& symbols, const RegisterSlots& regs) const;
+    string icode(const SymbolTable& symbols) const;
     // Read information from a string and build an IR representation
     // Assume that the input string does not contain spaces
-    Operand(const string& s, bool is_function = false);
+    Operand(string_view s, SymbolTable& symbols, bool is_function = false);
+    // Build an operand from its csir.h form (CSIRReg, CSIRVar...), as the
+    // binary IR stores it; name is an interned name id, unused by the forms without a symbol
+    Operand(unsigned char form, uint32_t name, long long value, SymbolTable& symbols, bool is_function = false);
 
     // local addr or local variable
     bool is_local() const;
@@ -69,11 +146,52 @@ class Operand {
     bool is_global() const;
     // register
     bool is_reg() const;
+    // register or variable, read by value (not an address)
+    bool is_value() const;
+};
+
+static_assert(sizeof(Operand) == 16 && std::is_trivially_copyable<Operand>::value, "Operand must stay a 16-byte POD");
+
+// The operands of an instruction, stored inline: no opcode takes more than two
+class OperandList {
+   private:
+    Operand slots[2];
+    unsigned char cnt;
+
+   public:
+    OperandList() : cnt(0){};
+    size_t size() const { return cnt; }
+    bool empty() const { return cnt == 0; }
+    Operand& operator[](size_t i) { return slots[i]; }
+    const Operand& operator[](size_t i) const { return slots[i]; }
+    Operand& front() { return slots[0]; }
+    const Operand& front() const { return slots[0]; }
+    Operand& back() { return slots[cnt - 1]; }
+    const Operand& back() const { return slots[cnt - 1]; }
+    Operand* begin() { return slots; }
+    const Operand* begin() const { return slots; }
+    Operand* end() { return slots + cnt; }
+    const Operand* end() const { return slots + cnt; }
+    template <typename... Args>
+    void emplace_back(Args&&... args) {
+        assert(cnt < 2);
+        slots[cnt++] = Operand(std::forward<Args>(args)...);
+    }
+    void push_back(const Operand& op) {
+        assert(cnt < 2);
+        slots[cnt++] = op;
+    }
+    // only ever shrinks: operands are dropped when an instruction is simplified
+    void resize(size_t n) {
+        assert(n <= cnt);
+        cnt = n;
+    }
+    void clear() { cnt = 0; }
 };
 
 class Opcode {
    public:
-    enum Type {
+    enum Type : unsigned char {
         INVALID = 0,
         ADD,
         SUB,
@@ -102,15 +220,72 @@ class Opcode {
         ASSIGN,  //assign the operand to the virtual register corresponding to this instruction
         END
     };
-    static map<Opcode::Type, int> operand_cnt;
+    // What an instruction of this opcode defines
+    enum Def : unsigned char {
+        DEF_NONE,
+        DEF_REG,   // the virtual register named by the instruction label, (label)
+        DEF_LAST,  // the last operand (move)
+    };
+    // Which operands are read, as seen by dse
+    enum Use : unsigned char {
+        USE_NONE,
+        USE_ALL,
+        USE_FIRST,
+    };
+    // Everything the passes need to know about an opcode.
+    // c_template is expanded by Instruction::ccode: %d is the register it defines,
+    // %0 and %1 are the operands; nullptr means the opcode needs special handling
+    struct Descriptor {
+        const char* name;
+        int operand_cnt;
+        Def def;
+        Use use;
+        bool is_arithmetic;
+        bool is_branch;
+        const char* c_template;
+    };
+    static constexpr Descriptor descriptors[END + 1] = {
+        {"invalid", 0, DEF_NONE, USE_NONE, false, false, ""},
+        {"add", 2, DEF_REG, USE_ALL, true, false, "%d = %0 + %1;"},
+        {"sub", 2, DEF_REG, USE_ALL, true, false, "%d = %0 - %1;"},
+        {"mul", 2, DEF_REG, USE_ALL, true, false, "%d = %0 * %1;"},
+        {"div", 2, DEF_REG, USE_ALL, true, false, "%d = %0 / %1;"},
+        {"mod", 2, DEF_REG, USE_ALL, false, false, "%d = %0 % %1;"},
+        {"neg", 1, DEF_REG, USE_ALL, false, false, "%d = -%0 ; "},
+        {"cmpeq", 2, DEF_REG, USE_ALL, true, false, "%d = %0 == %1;"},
+        {"cmple", 2, DEF_REG, USE_ALL, true, false, "%d = %0 <= %1;"},
+        {"cmplt", 2, DEF_REG, USE_ALL, true, false, "%d = %0 < %1;"},
+        {"br", 1, DEF_NONE, USE_NONE, false, true, "goto %0;"},
+        {"blbc", 2, DEF_NONE, USE_FIRST, false, true, "if(%0 == 0) goto %1;"},
+        {"blbs", 2, DEF_NONE, USE_FIRST, false, true, "if(%0 !=0) goto %1;"},
+        {"load", 1, DEF_REG, USE_ALL, false, false, "%d = *((long *)%0);"},
+        {"store", 2, DEF_NONE, USE_ALL, false, false, "*( (long *)%1) = %0;"},
+        {"move", 2, DEF_LAST, USE_FIRST, false, false, "%1 = %0;"},
+        {"read", 0, DEF_REG, USE_NONE, false, false, "ReadLong(%d);"},
+        {"write", 1, DEF_NONE, USE_ALL, false, false, "WriteLong(%0);"},
+        {"wrl", 0, DEF_NONE, USE_NONE, false, false, "WriteLine();"},
+        {"param", 1, DEF_NONE, USE_ALL, false, false, nullptr},
+        {"enter", 1, DEF_NONE, USE_NONE, false, false, nullptr},
+        {"entrypc", 0, DEF_NONE, USE_NONE, false, false, nullptr},
+        {"call", 1, DEF_NONE, USE_NONE, false, false, nullptr},
+        {"ret", 1, DEF_NONE, USE_NONE, false, false, "return ;"},
+        {"nop", 0, DEF_NONE, USE_NONE, false, false, ""},
+        {"assign", 1, DEF_REG, USE_ALL, true, false, "%d = %0;"},
+        {"end", 0, DEF_NONE, USE_NONE, false, false, ""}};
 
-    static map<Opcode::Type, string> opcode_name;
     Type type;
     Opcode() : type(Opcode::Type::INVALID){};
+    Opcode(Type t) : type(t){};
 
     // Read information from a string and build an IR representation
-    // Assume that the input string does not contain spaces
-    Opcode(const string& s);
+    // Assume that the input string is exactly one mnemonic, e.g. "add"
+    Opcode(string_view s) : type(from_name(s)){};
+    // Constant-time mnemonic recognizer, INVALID if s is not a mnemonic
+    static Type from_name(string_view s);
+
+    const Descriptor& info() const { return descriptors[type]; }
+    const char* name() const { return descriptors[type].name; }
+    int operand_cnt() const { return descriptors[type].operand_cnt; }
 };
 
 class Variable {
@@ -130,50 +305,62 @@ class Variable {
 
 class Instruction {
    public:
-    Opcode opcode;
-    vector<Operand> operands;
     long long label;
-    static deque<string> context;
+    OperandList operands;
+    uint32_t symbol;  // the virtual register (label) when the opcode defines one
+    Opcode opcode;
     Instruction() = delete;
     // Whether it is a basic block leader is not set in the constructor
-    Instruction(const string& s);
-    string ccode() const;
-    string icode() const;
+    // Tokenize "instr N: op a b" in a single forward pass
+    Instruction(string_view s, SymbolTable& symbols);
+    // An instruction without operands yet, for the binary IR decoder to fill
+    Instruction(long long _label, Opcode _opcode, SymbolTable& symbols);
+    // args collects the operands of param instructions until the call that takes them,
+    // one list per emission so that functions can be emitted concurrently
+    string ccode(const SymbolTable& symbols, const RegisterSlots& regs, vector<string>& args) const;
+    // The same without the label a branch target gets
+    string cstatement(const SymbolTable& symbols, const RegisterSlots& regs, vector<string>& args) const;
+    string icode(const SymbolTable& symbols) const;
     bool is_branch() const;
     // Whether it is a basic block leader,  not set in the constructor
     bool is_block_leader;
+    // Whether some branch jumps here and the C backend needs a label, not set in the constructor
+    // The predecessors themselves are kept on the BasicBlock
+    bool is_branch_target;
     long long branch_target_label() const;
-    // Not set in the constructor
-    vector<long long> predecessor_labels;
     // set the Instruction to nop
     void to_nop();
-    string get_def() const;
+    // The symbol defined by this instruction, SymbolTable::NONE if there is none
+    uint32_t get_def() const;
     // For the convenience of dse
     // Since only defs to local variables and virtual registers can be eliminated
     // Only use of local variables and virtual registers are considered
-    vector<string> get_use_dse() const;
-    string get_def_dse() const;
+    // Unused slots are SymbolTable::NONE
+    array<uint32_t, 2> get_use_dse() const;
+    uint32_t get_def_dse() const;
     bool is_def() const;
     bool is_constant_def() const;
     long long const_def_val() const;
     bool is_arithmetic() const;
 
-    static int peephole2_cnt;
-    // add 1 2 -> assign 3
-    void peephole2();
-    static int peephole3_cnt;
-    // add (90) 0 -> assign (90)
-    void peephole3();
+    // add 1 2 -> assign 3, returns whether it applied
+    bool peephole2();
+    // add (90) 0 -> assign (90), returns whether it applied
+    bool peephole3();
 };
 
+static_assert(std::is_trivially_copyable<Instruction>::value, "Instruction must stay trivially copyable");
+
 class BasicBlock {
    public:
-    vector<Instruction> instructions;
-    vector<long long> predecessor_labels;
-    vector<long long> successor_labels;
-    BasicBlock(vector<Instruction>& instrs);
-    string ccode() const;
-    string icode() const;
+    // allocated from the owning Program's memory resource
+    std::pmr::vector<Instruction> instructions;
+    std::pmr::vector<long long> predecessor_labels;
+    std::pmr::vector<long long> successor_labels;
+    // copy the instructions [first, last) into the block
+    BasicBlock(const Instruction* first, const Instruction* last, std::pmr::memory_resource* resource);
+    string ccode(const SymbolTable& symbols, const RegisterSlots& regs, vector<string>& args) const;
+    string icode(const SymbolTable& symbols) const;
     string cfg() const;
     long long first_label() const;  // The label of the first instruction in this basic block
     long long last_label() const;   // The label of the last instruction in this basic block
@@ -185,55 +372,367 @@ class BasicBlock {
     void peephole2();
 };
 
+class Function;
+// Def-use and use-def chains of a function: for every object (variable,
+// parameter, global or virtual register) the instructions that define it
+// and the operands that read it or take its address. Objects are numbered
+// densely; instructions are numbered label - label_0. The chains are
+// flow-insensitive: a register has exactly one definition, and the
+// definitions of a variable that reach a given use are the subset reaching
+// definitions select. The chains of one object are unordered once edited.
+class DefUse {
+   public:
+    // An operand reading an object: slot operand of instruction inst
+    struct Site {
+        uint32_t inst;
+        uint32_t operand;
+    };
+    template <typename T>
+    struct Range {
+        const T* first;
+        const T* last;
+        const T* begin() const { return first; }
+        const T* end() const { return last; }
+        size_t size() const { return last - first; }
+        bool empty() const { return first == last; }
+    };
+
+   private:
+    unordered_map<uint32_t, uint32_t> object_of_symbol;
+    vector<uint32_t> symbol_of_object;
+    // the definitions of object o are defs[def_start[o] .. def_start[o] + def_cnt[o]), uses likewise
+    vector<uint32_t> def_start, def_cnt, defs;
+    vector<uint32_t> use_start, use_cnt;
+    vector<Site> uses;
+    // per instruction, where its definition and operands sit in defs and uses, so edits are O(1)
+    vector<uint32_t> def_pos;
+    vector<array<uint32_t, 2>> use_pos;
+    vector<array<uint32_t, 2>> operand_objects;
+
+   public:
+    long long label_0 = 0;
+    vector<uint32_t> object_of_def;  // per instruction, the object it defines, NONE if none
+    vector<uint32_t> block_of_inst;  // per instruction, its index in Function::basic_blocks
+
+    DefUse() = default;
+    explicit DefUse(const Function& func);
+    size_t object_cnt() const { return symbol_of_object.size(); }
+    // The object of a symbol, NONE if the function never mentions it
+    uint32_t object(uint32_t symbol) const;
+    uint32_t symbol(uint32_t object) const { return symbol_of_object[object]; }
+    // The object operand slot k of instruction inst reads, NONE if it reads none
+    uint32_t operand_object(uint32_t inst, size_t k) const { return operand_objects[inst][k]; }
+    Range<uint32_t> defs_of(uint32_t object) const {
+        return {defs.data() + def_start[object], defs.data() + def_start[object] + def_cnt[object]};
+    }
+    Range<Site> uses_of(uint32_t object) const {
+        return {uses.data() + use_start[object], uses.data() + use_start[object] + use_cnt[object]};
+    }
+    // Keep the chains in step with an edit, before it is made:
+    // the instruction becomes a nop
+    void erase_instruction(uint32_t inst);
+    // operand slot k of the instruction becomes a constant
+    void erase_use(uint32_t inst, size_t k);
+};
+
+// What scp may assume about the rest of the program, as Program::ipcp works it out.
+// With a context, scp also follows the moves within a block and substitutes
+// into every operand read by value, where lab2's scp only rewrites arithmetic
+struct ScpContext {
+    // parameters and globals (by symbol) that hold a known constant on entry
+    unordered_map<uint32_t, long long> entry_constants;
+    // The globals (sorted symbols) each callee, by function id, may write; a
+    // call to an id not in it may write any. Null: lab2's rule, where a call
+    // may write any global but the moves to globals of its own block
+    const unordered_map<long long, vector<uint32_t>>* mod = nullptr;
+};
+
+// The constants passed to one call, after scp
+struct CallSite {
+    long long callee;                            // function id
+    vector<std::optional<long long>> args;       // in param order, nullopt if not constant
+    unordered_map<uint32_t, long long> globals;  // the globals (by symbol) holding a constant at the call
+};
+
+// Immediate dominators and dominance frontiers of the blocks of a function,
+// by the iterative algorithm of Cooper, Harvey and Kennedy over reverse
+// postorder. Blocks are indexed as Function::basic_blocks. Post-dominators
+// are the same over the reversed CFG, rooted at a virtual exit (index
+// basic_blocks.size()) that follows every block without successors.
+class DominatorTree {
+   public:
+    vector<vector<int>> preds, succs;  // the CFG as block indices, reversed for post-dominators
+    int root = 0;                      // the entry, or the virtual exit
+    vector<int> rpo;                   // blocks reachable from the root in reverse postorder
+    vector<int> rpo_number;            // position in rpo, -1 if unreachable
+    vector<int> idom;                  // the root is its own idom, -1 if unreachable
+    vector<vector<int>> children;      // the dominator tree
+    vector<vector<int>> frontier;      // dominance frontiers
+
+    DominatorTree() = default;
+    explicit DominatorTree(const Function& func, bool post = false);
+    bool reachable(int b) const { return rpo_number[b] >= 0; }
+    // Whether a dominates b (or a == b), in constant time; both must be reachable
+    bool dominates(int a, int b) const { return first[a] <= first[b] && first[b] <= last[a]; }
+
+   private:
+    // the preorder interval of each subtree of the dominator tree
+    vector<int> first, last;
+};
+
+// The natural loops of a function nested into a forest. A loop is a header
+// with the back edges into it, from the blocks it dominates (the latches),
+// and every block that reaches a latch without passing the header. Loops
+// sharing a header are one loop. A retreating edge into a block that does
+// not dominate its source (irreducible control flow) makes no loop.
+class LoopForest {
+   public:
+    struct Loop {
+        int header;
+        int parent;           // the innermost enclosing loop, -1 if none
+        int depth;            // 1 for an outermost loop
+        vector<int> latches;  // sorted, like every list of blocks here
+        vector<int> blocks;   // every block of the loop, those of the nested loops included
+        vector<int> exits;    // the blocks outside the loop with a predecessor inside
+        vector<int> children;
+    };
+    vector<Loop> loops;    // in reverse postorder of the headers: outer loops before inner
+    vector<int> loop_of;   // per block, the innermost loop containing it, -1 if none
+    vector<int> roots;     // the outermost loops
+
+    LoopForest() = default;
+    LoopForest(const Function& func, const DominatorTree& dom);
+    // The loop depth of block b, 0 outside every loop
+    int depth(int b) const { return loop_of[b] < 0 ? 0 : loops[loop_of[b]].depth; }
+    // Whether block b is in loop l, nested loops included
+    bool contains(int l, int b) const {
+        return loop_of[b] >= 0 && first[l] <= first[loop_of[b]] && first[loop_of[b]] <= last[l];
+    }
+
+   private:
+    vector<int> first, last;  // the preorder interval of each loop in the forest
+};
+
 class Function {
    private:
+    // Built by chains() when first needed, see chains_valid
+    DefUse def_use;
+    bool chains_valid = false;
+    // Built by dominators(), post_dominators() and loops() when first needed
+    DominatorTree dom_tree, post_dom_tree;
+    LoopForest loop_forest;
+    bool dominators_valid = false, post_dominators_valid = false, loops_valid = false;
     // Scan all operands for local variables
-    void scan_local_variables(vector<Instruction>& instrs);
+    void scan_local_variables(const Instruction* first, const Instruction* last, const SymbolTable& symbols);
     // Scan all operands for function parameters
-    void scan_parameters(vector<Instruction>& instrs);
+    void scan_parameters(const Instruction* first, const Instruction* last, const SymbolTable& symbols);
     // Scan all instructions for basic block leaders
     // this function will modify the instrs passed as arguments
     // assuming the labels in the instrs is continuous and in an ascending order
-    void scan_block_leaders(vector<Instruction>& instrs);
+    void scan_block_leaders(Instruction* first, Instruction* last);
 
    public:
     bool is_main;
     vector<Variable> local_variables;
     vector<Variable> params;
-    vector<BasicBlock> basic_blocks;
-    unordered_map<long long, int> idx_of_bb;  // index of basic blocks in the vector, initialized in constructor
+    std::pmr::vector<BasicBlock> basic_blocks;
+    std::pmr::unordered_map<long long, int> idx_of_bb;  // index of basic blocks in the vector, initialized in constructor
     long long local_var_size;                 // size of local variables in bytes
     long long param_size;                     // size of parameters in bytes
     long long id;
     Function() : local_variables({}), params({}), local_var_size(0), param_size(0), is_main(false){};
-    // the first instruction must be enter ,the last must be ret
-    Function(vector<Instruction>& instrs, bool _is_main = false);
-    string ccode() const;
-    string icode() const;
+    // the instructions [first, last) of one function: the first must be enter, the last must be ret
+    // Blocks are allocated from resource; leader flags are set in place
+    Function(Instruction* first, Instruction* last, const SymbolTable& symbols,
+             std::pmr::memory_resource* resource, bool _is_main = false);
+    // The registers are emitted as locals, see allocate_registers. Structured,
+    // the blocks become nested while, do-while and if statements where the
+    // layout allows (see structured_ccode); otherwise every branch is a goto
+    string ccode(const SymbolTable& symbols, bool structured = true) const;
+    // The blocks as C statements, with a goto left only for an edge that
+    // does not fit the nesting of the loops and ifs recovered from the layout
+    string structured_ccode(const SymbolTable& symbols, const RegisterSlots& regs) const;
+    string icode(const SymbolTable& symbols) const;
     string cfg() const;
+    // Liveness over the virtual registers, and a slot for each of them such
+    // that registers live at the same time never share one
+    RegisterSlots allocate_registers(const SymbolTable& symbols) const;
     int constant_propagated_cnt;  // It is only allowed to be modified by the function scp
     void scp();                   // simple constant propagation using reaching definition analysis
-    void scp_peephole();          // Peephole optimization can provide more opportunities for scp
+    // Peephole optimization can provide more opportunities for scp.
+    // With a context, scp also assumes its entry constants and call effects,
+    // and the constants passed at every call are appended to calls
+    void scp_peephole(const ScpContext* context = nullptr, vector<CallSite>* calls = nullptr);
     void dse();                   // dead statement elimination
     int statement_eliminated_cnt;
+    // Value numbering over the dominator tree: a computation a dominating
+    // register already holds becomes an assign of that register
+    void gvn();
+    int expressions_eliminated_cnt = 0;
+    // Loop-invariant code motion: hoist invariant arithmetic and safe loads
+    // out of every natural loop into a preheader, inner loops first
+    void licm(const SymbolTable& symbols);
+    int instructions_hoisted_cnt = 0;
+    // Induction variable strength reduction: values linear in a basic
+    // induction variable through a mul get a variable of their own, bumped
+    // along with it, inner loops first. New instructions take their labels
+    // from next_label on, and the function is relabelled from its first
+    void reduce_strength(SymbolTable& symbols, long long& next_label);
+    int multiplications_reduced_cnt = 0;
+    // Replace each call in callee_at, keyed by its label, with a copy of the
+    // callee's body, its parameters and locals becoming locals of this
+    // function. The copies take their labels from next_label on, and the
+    // function is relabelled from its first
+    void inline_calls(const unordered_map<long long, const Function*>& callee_at, SymbolTable& symbols,
+                      long long& next_label);
+    int calls_inlined_cnt = 0;
+    // CFG cleanup after scp: fold branches on constant conditions, drop
+    // unreachable blocks, thread branches through blocks that only branch on,
+    // and merge blocks with a single way in. A function that changes is
+    // relabelled from its first, and may shrink
+    void simplify_cfg(const SymbolTable& symbols);
+    int blocks_removed_cnt = 0;
+    int branches_removed_cnt = 0;
+    // The instructions laid out again, for relabel(): preheaders[l], when not
+    // empty, is a block right before the header of loop l that the branches
+    // from outside the loop go to, after[label] follows that instruction and
+    // dropped instructions are left out. No block may lose all of them.
+    vector<Instruction> layout(const vector<vector<Instruction>>& preheaders,
+                               const unordered_map<long long, vector<Instruction>>& after,
+                               const unordered_set<long long>& dropped);
+    // Replace the instructions with insts, a new layout of them starting with
+    // the enter: they are renumbered from first (by default the function's
+    // first label) on, with register reads and branch targets following their
+    // instructions, and the blocks are rebuilt. New instructions need labels
+    // no other instruction of the function has. Labels outside the function
+    // stay valid as long as its size and first label do not change, see
+    // Program::renumber otherwise.
+    void relabel(vector<Instruction>& insts, const SymbolTable& symbols, long long first = -1);
+    long long dataflow_iterations = 0;  // blocks visited by the dataflow solver in scp and dse
+    // The def-use chains, built on first use. scp and dse keep them in step
+    // through DefUse::erase_*; any other edit of the instructions must call
+    // invalidate_chains() so the next chains() rebuilds them
+    DefUse& chains();
+    void invalidate_chains() { chains_valid = false; }
+    // The CFG analyses, built on first use. Any edit of the blocks or of their
+    // successor and predecessor labels must call invalidate_cfg()
+    const DominatorTree& dominators();
+    const DominatorTree& post_dominators();
+    const LoopForest& loops();
+    void invalidate_cfg() { dominators_valid = post_dominators_valid = loops_valid = false; }
+    // -backend=cfg-analysis: the cfg output followed by the analyses
+    string cfg_analysis();
 };
 
+// The whole input, mmap-ed when it is a regular file and bulk-read otherwise
+class InputBuffer {
+   private:
+    char* data;
+    size_t length;
+    bool mapped;
+
+   public:
+    InputBuffer(int fd);
+    ~InputBuffer();
+    InputBuffer(const InputBuffer&) = delete;
+    InputBuffer& operator=(const InputBuffer&) = delete;
+    string_view text() const { return string_view(data, length); }
+};
+
+// atoll() over a string_view, without copying it into a C string
+long long to_ll(string_view s);
+
+// Build an instruction from every "instr" line of the text
+vector<Instruction> parse_instructions(string_view text, SymbolTable& symbols);
+// The same on up to jobs threads: the text is cut into chunks after ret lines,
+// each chunk is tokenized with its own symbol table, and the tables are merged
+// in chunk order, so the result is identical to the serial parse
+vector<Instruction> parse_instructions(string_view text, SymbolTable& symbols, int jobs);
+
+// Whether the input is the binary IR of csir.h ("csc -binary") rather than text
+bool is_binary_ir(string_view data);
+// Decode the binary IR straight into instructions, without any text parsing.
+// Malformed input sets error to what is wrong with it and yields no instructions
+vector<Instruction> parse_binary_instructions(string_view data, SymbolTable& symbols, string& error);
+
+class ThreadPool;
 class Program {
    private:
-    // Scan all operands for global variables
-    void scan_global_variables(vector<Instruction>& instrs);
+    // Scan all operands for global variables, appending them unsorted to out
+    void scan_global_variables(const Instruction* first, const Instruction* last, vector<Variable>& out) const;
+    // Sort, unique and size the scanned global variables, in declaration order
+    void layout_global_variables();
+    // With use_arena, all blocks live in monotonic buffers (one per group of
+    // functions built together) released in one shot with the Program;
+    // otherwise in the global heap
+    vector<std::unique_ptr<std::pmr::monotonic_buffer_resource>> arenas;
+    // Threads for the per-function passes and emission, null when serial
+    std::shared_ptr<ThreadPool> pool;
+    // Run body(i) for every i in [0, n), on the pool if there is one
+    void for_each_task(size_t n, const std::function<void(size_t)>& body) const;
+    // Run body(i) for every function i, likewise
+    void for_each_function(const std::function<void(size_t)>& body) const;
 
    public:
+    SymbolTable symbols;
     vector<Variable> global_variables;
     vector<Function> functions;
-    Program(vector<Instruction>& insts);
+    // With jobs > 1, functions are built, optimized and emitted on up to jobs
+    // threads; the output is the same whatever jobs is
+    Program(vector<Instruction>& insts, SymbolTable&& _symbols, bool use_arena = false, int jobs = 1);
+    // An empty program, filled one function at a time by stream()
+    Program(SymbolTable&& _symbols);
+    std::pmr::memory_resource* resource(size_t group = 0) const;
     long long instruction_cnt;
-    string ccode() const;
+    // The label for the next new instruction: above every label any
+    // instruction ever had, so that the register it defines gets a symbol of
+    // its own. advance_next_label() moves it past the labels in use.
+    long long next_label = 0;
+    void advance_next_label();
+    // Lay the functions out again once some have grown or shrunk, and make
+    // the calls follow the new ids. The first function starts at first, by
+    // default its own id
+    void renumber(long long first = -1);
+    // #include and #define lines every C translation starts with
+    static string ccode_prelude();
+    // -backend=c, or -backend=c-goto for every branch as a goto
+    string ccode(bool structured = true) const;
     string icode() const;
     string cfg() const;
+    string cfg_analysis();
     void scp();  //simple constant propagation using reaching definition analysis
+    // scp across calls (-opt=ipcp): mod/ref summaries of the globals bottom-up
+    // over the call graph, then constant parameters and globals top-down from
+    // the call sites into the callees. SCCs of one level run in parallel
+    void ipcp();
     void dse();
+    void gvn();
+    void licm();
+    // -opt=ivs: reduce_strength on every function, which may grow, so the
+    // functions are laid out again after it
+    void reduce_strength();
+    // -opt=inline: inline_calls on every function, bottom-up over the call
+    // graph, for the calls a size cost model admits. Functions whose calls
+    // were all inlined are dropped, and the rest laid out again
+    void inline_calls();
+    // -opt=simplifycfg: simplify_cfg on every function, which may shrink,
+    // so the functions are laid out again after it
+    void simplify_cfg();
     void scp_report() const;
     void dse_report() const;
+    void gvn_report() const;
+    void licm_report() const;
+    void ivs_report() const;
+    void inline_report() const;
+    void simplify_cfg_report() const;
+    // -dataflow-stats: blocks and solver visits per function, on stderr
+    void dataflow_report() const;
+
+    // -stream: read instructions from fd and build, optimize, emit and free
+    // each function as soon as its ret is read, so memory stays bounded by the
+    // largest function. The C backend declares the globals with extern as
+    // they are discovered and defines them in a trailer. Binary input is
+    // refused, with nothing emitted, by returning false.
+    bool stream(int fd, bool do_scp, bool do_dse, bool do_rep, const string& backend, std::ostream& out);
 };
 #endif  //IR_H
\ No newline at end of file
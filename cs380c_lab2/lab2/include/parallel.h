@@ -0,0 +1,147 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Run body(i) for every i in [0, n) on up to jobs threads, the calling
+// thread included. Indices are handed out in increasing order, so callers
+// that write result i into slot i stay deterministic whatever the schedule.
+template <typename F>
+void parallel_for(size_t n, int jobs, F&& body) {
+    if (jobs <= 1 || n <= 1) {
+        for (size_t i = 0; i < n; i++)
+            body(i);
+        return;
+    }
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i; (i = next.fetch_add(1)) < n;)
+            body(i);
+    };
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < std::min(n, size_t(jobs)); t++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& t : threads)
+        t.join();
+}
+
+// A fixed set of threads for running one task per function, where tasks
+// differ in cost by orders of magnitude. Each thread owns a deque of task
+// indices: it takes work from the back of its own and, once that is empty,
+// steals from the front of the others'. The threads live as long as the
+// pool, so a sequence of passes pays for starting them only once.
+class ThreadPool {
+   private:
+    struct Queue {
+        std::mutex lock;
+        std::deque<size_t> tasks;
+    };
+    std::vector<std::unique_ptr<Queue>> queues;  // one per thread, queues[0] is the caller's
+    std::vector<std::thread> threads;
+    std::mutex lock;  // guards everything below
+    std::condition_variable wake, done;
+    std::function<void(size_t)> body;
+    size_t generation = 0;  // bumped when a batch is posted
+    size_t pending = 0;     // tasks of the current batch not yet finished
+    bool stopping = false;
+
+    bool next_task(size_t self, size_t& task) {
+        {
+            std::lock_guard<std::mutex> guard(queues[self]->lock);
+            auto& own = queues[self]->tasks;
+            if (!own.empty()) {
+                task = own.back();
+                own.pop_back();
+                return true;
+            }
+        }
+        for (size_t k = 1; k < queues.size(); k++) {
+            auto& victim = *queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+    void work(size_t self) {
+        for (size_t task; next_task(self, task);) {
+            body(task);
+            std::lock_guard<std::mutex> guard(lock);
+            if (--pending == 0)
+                done.notify_all();
+        }
+    }
+    void worker(size_t self) {
+        size_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [&] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+            }
+            work(self);
+        }
+    }
+
+   public:
+    explicit ThreadPool(int jobs) {
+        for (int t = 0; t < std::max(jobs, 1); t++)
+            queues.emplace_back(new Queue);
+        for (int t = 1; t < jobs; t++)
+            threads.emplace_back(&ThreadPool::worker, this, t);
+    }
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : threads)
+            t.join();
+    }
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    size_t size() const { return queues.size(); }
+
+    // Run f(i) for every i in [0, n) and return when all are done; the
+    // calling thread works too. Tasks are dealt out in contiguous runs, so
+    // without stealing every thread walks its own slice in reverse.
+    template <typename F>
+    void for_each(size_t n, F&& f) {
+        if (threads.empty() || n <= 1) {
+            for (size_t i = 0; i < n; i++)
+                f(i);
+            return;
+        }
+        {
+            // under lock, so that no thread finishes a task before pending is set
+            std::lock_guard<std::mutex> guard(lock);
+            body = [&f](size_t i) { f(i); };
+            pending = n;
+            for (size_t q = 0; q < queues.size(); q++) {
+                std::lock_guard<std::mutex> queue_guard(queues[q]->lock);
+                for (auto i = n * q / queues.size(); i < n * (q + 1) / queues.size(); i++)
+                    queues[q]->tasks.push_back(i);
+            }
+            generation++;
+        }
+        wake.notify_all();
+        work(0);
+        std::unique_lock<std::mutex> guard(lock);
+        done.wait(guard, [&] { return pending == 0; });
+    }
+};
+#endif  //PARALLEL_H
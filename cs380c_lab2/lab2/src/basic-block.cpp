@@ -1,33 +1,36 @@
 #include <algorithm>
 
 #include "ir.h"
-BasicBlock::BasicBlock(vector<Instruction>& instrs) : instructions(instrs), predecessor_labels({}), successor_labels({}) {
-    if (instrs.back().is_branch()) {
-        this->successor_labels.push_back(instrs.back().operands.back().inst_label);
+BasicBlock::BasicBlock(const Instruction* first, const Instruction* last, std::pmr::memory_resource* resource)
+    : instructions(first, last, resource), predecessor_labels(resource), successor_labels(resource) {
+    const auto& back = instructions.back();
+    successor_labels.reserve(2);
+    if (back.is_branch()) {
+        this->successor_labels.push_back(back.operands.back().inst_label);
     }
-    if (instrs.back().opcode.type != Opcode::Type::BR && instrs.back().opcode.type != Opcode::Type::RET) {
-        this->successor_labels.push_back(instrs.back().label + 1);
+    if (back.opcode.type != Opcode::Type::BR && back.opcode.type != Opcode::Type::RET) {
+        this->successor_labels.push_back(back.label + 1);
     }
     sort(successor_labels.begin(), successor_labels.end());
     auto iter = std::unique(successor_labels.begin(), successor_labels.end());
-    successor_labels = vector<long long>(successor_labels.begin(), iter);
+    successor_labels.erase(iter, successor_labels.end());
     peephole();
     assert(last_label()-first_label()==size()-1);
 }
 
-string BasicBlock::ccode() const {
+string BasicBlock::ccode(const SymbolTable& symbols, const RegisterSlots& regs, vector<string>& args) const {
     std::stringstream tmp;
     for (auto& inst : instructions) {
-        auto code =inst.ccode();
+        auto code =inst.ccode(symbols, regs, args);
         if(code.size()>0)
         tmp << "  " << code << std::endl;
     }
     return tmp.str();
 }
-string BasicBlock::icode() const {
+string BasicBlock::icode(const SymbolTable& symbols) const {
     std::stringstream tmp;
     for (auto& inst : instructions) {
-        tmp << inst.icode();
+        tmp << inst.icode(symbols);
     }
     return tmp.str();
 }
@@ -61,7 +64,7 @@ void BasicBlock::peephole() {
     for (auto iter = instructions.begin(); iter != instructions.end() - 1; ++iter) {
         auto next_iter = iter + 1;
         if (iter->opcode.type == Opcode::Type::ADD && (iter->operands[1].type == Operand::Type::FP || iter->operands[1].type == Operand::Type::GP)) {
-            if (next_iter->operands.back().type == Operand::Type::REG && next_iter->operands.back().reg_name == iter->label) {
+            if (!next_iter->operands.empty() && next_iter->operands.back().type == Operand::Type::REG && next_iter->operands.back().reg_name == iter->label) {
                 if (next_iter->opcode.type == Opcode::Type::LOAD) {
                     next_iter->opcode.type = Opcode::Type::ASSIGN;
                     next_iter->operands[0] = iter->operands[0];
@@ -0,0 +1,197 @@
+#include "bitset.h"
+
+// the vector kernels are x86 only; elsewhere the scalar ones are all there is
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+namespace {
+void scalar_or_into(uint64_t* dst, const uint64_t* src, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] |= src[i];
+}
+void scalar_and_into(uint64_t* dst, const uint64_t* src, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] &= src[i];
+}
+void scalar_andnot_into(uint64_t* dst, const uint64_t* src, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        dst[i] &= ~src[i];
+}
+bool scalar_equal(const uint64_t* a, const uint64_t* b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] != b[i])
+            return false;
+    }
+    return true;
+}
+bool scalar_transfer(uint64_t* dst, const uint64_t* gen, const uint64_t* x, const uint64_t* kill, size_t n) {
+    uint64_t changed = 0;
+    for (size_t i = 0; i < n; i++) {
+        auto w = gen[i] | (x[i] & ~kill[i]);
+        changed |= w ^ dst[i];
+        dst[i] = w;
+    }
+    return changed != 0;
+}
+
+#ifdef HAVE_X86_KERNELS
+// AVX2: four words at a time, the tail word by word. Sets shorter than one
+// vector go to the scalar loop, which is cheaper than setting up the vector one
+#define AVX2 __attribute__((target("avx2")))
+AVX2 void avx2_or_into(uint64_t* dst, const uint64_t* src, size_t n) {
+    if (n < 4)
+        return scalar_or_into(dst, src, n);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        auto d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        auto s = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_or_si256(d, s));
+    }
+    scalar_or_into(dst + i, src + i, n - i);
+}
+AVX2 void avx2_and_into(uint64_t* dst, const uint64_t* src, size_t n) {
+    if (n < 4)
+        return scalar_and_into(dst, src, n);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        auto d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        auto s = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_and_si256(d, s));
+    }
+    scalar_and_into(dst + i, src + i, n - i);
+}
+AVX2 void avx2_andnot_into(uint64_t* dst, const uint64_t* src, size_t n) {
+    if (n < 4)
+        return scalar_andnot_into(dst, src, n);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        auto d = _mm256_loadu_si256((const __m256i*)(dst + i));
+        auto s = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_andnot_si256(s, d));
+    }
+    scalar_andnot_into(dst + i, src + i, n - i);
+}
+AVX2 bool avx2_equal(const uint64_t* a, const uint64_t* b, size_t n) {
+    if (n < 4)
+        return scalar_equal(a, b, n);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        auto d = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(a + i)), _mm256_loadu_si256((const __m256i*)(b + i)));
+        if (!_mm256_testz_si256(d, d))
+            return false;
+    }
+    return scalar_equal(a + i, b + i, n - i);
+}
+AVX2 bool avx2_transfer(uint64_t* dst, const uint64_t* gen, const uint64_t* x, const uint64_t* kill, size_t n) {
+    if (n < 4)
+        return scalar_transfer(dst, gen, x, kill, n);
+    size_t i = 0;
+    auto changed = _mm256_setzero_si256();
+    for (; i + 4 <= n; i += 4) {
+        auto g = _mm256_loadu_si256((const __m256i*)(gen + i));
+        auto v = _mm256_loadu_si256((const __m256i*)(x + i));
+        auto k = _mm256_loadu_si256((const __m256i*)(kill + i));
+        auto w = _mm256_or_si256(g, _mm256_andnot_si256(k, v));
+        changed = _mm256_or_si256(changed, _mm256_xor_si256(w, _mm256_loadu_si256((const __m256i*)(dst + i))));
+        _mm256_storeu_si256((__m256i*)(dst + i), w);
+    }
+    bool tail_changed = scalar_transfer(dst + i, gen + i, x + i, kill + i, n - i);
+    return !_mm256_testz_si256(changed, changed) || tail_changed;
+}
+#undef AVX2
+
+// AVX-512: eight words at a time, the tail under a mask; short sets as for AVX2
+#define AVX512 __attribute__((target("avx512f")))
+AVX512 inline __mmask8 tail_mask(size_t left) {
+    return left >= 8 ? 0xff : (__mmask8)((1u << left) - 1);
+}
+AVX512 void avx512_or_into(uint64_t* dst, const uint64_t* src, size_t n) {
+    if (n < 8)
+        return scalar_or_into(dst, src, n);
+    for (size_t i = 0; i < n; i += 8) {
+        auto m = tail_mask(n - i);
+        auto d = _mm512_maskz_loadu_epi64(m, dst + i);
+        auto s = _mm512_maskz_loadu_epi64(m, src + i);
+        _mm512_mask_storeu_epi64(dst + i, m, _mm512_or_si512(d, s));
+    }
+}
+AVX512 void avx512_and_into(uint64_t* dst, const uint64_t* src, size_t n) {
+    if (n < 8)
+        return scalar_and_into(dst, src, n);
+    for (size_t i = 0; i < n; i += 8) {
+        auto m = tail_mask(n - i);
+        auto d = _mm512_maskz_loadu_epi64(m, dst + i);
+        auto s = _mm512_maskz_loadu_epi64(m, src + i);
+        _mm512_mask_storeu_epi64(dst + i, m, _mm512_and_si512(d, s));
+    }
+}
+AVX512 void avx512_andnot_into(uint64_t* dst, const uint64_t* src, size_t n) {
+    if (n < 8)
+        return scalar_andnot_into(dst, src, n);
+    for (size_t i = 0; i < n; i += 8) {
+        auto m = tail_mask(n - i);
+        auto d = _mm512_maskz_loadu_epi64(m, dst + i);
+        auto s = _mm512_maskz_loadu_epi64(m, src + i);
+        _mm512_mask_storeu_epi64(dst + i, m, _mm512_andnot_si512(s, d));
+    }
+}
+AVX512 bool avx512_equal(const uint64_t* a, const uint64_t* b, size_t n) {
+    if (n < 8)
+        return scalar_equal(a, b, n);
+    for (size_t i = 0; i < n; i += 8) {
+        auto m = tail_mask(n - i);
+        if (_mm512_mask_cmpneq_epi64_mask(m, _mm512_maskz_loadu_epi64(m, a + i), _mm512_maskz_loadu_epi64(m, b + i)))
+            return false;
+    }
+    return true;
+}
+AVX512 bool avx512_transfer(uint64_t* dst, const uint64_t* gen, const uint64_t* x, const uint64_t* kill, size_t n) {
+    if (n < 8)
+        return scalar_transfer(dst, gen, x, kill, n);
+    __mmask8 changed = 0;
+    for (size_t i = 0; i < n; i += 8) {
+        auto m = tail_mask(n - i);
+        auto g = _mm512_maskz_loadu_epi64(m, gen + i);
+        auto v = _mm512_maskz_loadu_epi64(m, x + i);
+        auto k = _mm512_maskz_loadu_epi64(m, kill + i);
+        // 0xf4: g | (v & ~k) as a truth table over (g, v, k)
+        auto w = _mm512_ternarylogic_epi64(g, v, k, 0xf4);
+        changed |= _mm512_mask_cmpneq_epi64_mask(m, w, _mm512_maskz_loadu_epi64(m, dst + i));
+        _mm512_mask_storeu_epi64(dst + i, m, w);
+    }
+    return changed != 0;
+}
+#undef AVX512
+#endif
+
+const BitsetKernels scalar = {"scalar", scalar_or_into, scalar_and_into, scalar_andnot_into, scalar_equal, scalar_transfer};
+#ifdef HAVE_X86_KERNELS
+const BitsetKernels avx2 = {"avx2", avx2_or_into, avx2_and_into, avx2_andnot_into, avx2_equal, avx2_transfer};
+const BitsetKernels avx512 = {"avx512", avx512_or_into, avx512_and_into, avx512_andnot_into, avx512_equal, avx512_transfer};
+#endif
+}  // namespace
+
+std::vector<const BitsetKernels*> available_bitset_kernels() {
+    std::vector<const BitsetKernels*> res = {&scalar};
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        res.push_back(&avx2);
+    if (__builtin_cpu_supports("avx512f"))
+        res.push_back(&avx512);
+#endif
+    return res;
+}
+
+const BitsetKernels* bitset_kernels = available_bitset_kernels().back();
+
+bool select_bitset_kernels(const std::string& name) {
+    for (auto kernels : available_bitset_kernels()) {
+        if (name == kernels->name) {
+            bitset_kernels = kernels;
+            return true;
+        }
+    }
+    return false;
+}
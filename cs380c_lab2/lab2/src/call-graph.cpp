@@ -0,0 +1,106 @@
+#include "call-graph.h"
+
+#include <algorithm>
+CallGraph::CallGraph(const vector<Function>& functions) {
+    const int n = functions.size();
+    unordered_map<long long, int> index_of_id;
+    for (int f = 0; f < n; f++)
+        index_of_id[functions[f].id] = f;
+    callees.resize(n);
+    callers.resize(n);
+    calls_unknown.assign(n, false);
+    for (int f = 0; f < n; f++) {
+        for (const auto& bb : functions[f].basic_blocks) {
+            for (const auto& inst : bb.instructions) {
+                if (inst.opcode.type != Opcode::Type::CALL)
+                    continue;
+                auto iter = index_of_id.find(inst.operands[0].function_id);
+                if (iter == index_of_id.end())
+                    calls_unknown[f] = true;
+                else
+                    callees[f].push_back(iter->second);
+            }
+        }
+        std::sort(callees[f].begin(), callees[f].end());
+        callees[f].erase(std::unique(callees[f].begin(), callees[f].end()), callees[f].end());
+        for (auto c : callees[f])
+            callers[c].push_back(f);
+    }
+
+    // Tarjan's algorithm with an explicit stack of (function, next callee to
+    // visit); it completes an SCC only after every SCC reachable from it
+    scc_of.assign(n, -1);
+    vector<int> index(n, -1), low(n, 0), members;
+    vector<char> on_stack(n, false);
+    vector<std::pair<int, size_t>> stack;
+    int visited = 0;
+    for (int root = 0; root < n; root++) {
+        if (index[root] != -1)
+            continue;
+        stack.emplace_back(root, 0);
+        while (!stack.empty()) {
+            auto [f, next] = stack.back();
+            if (next == 0) {
+                index[f] = low[f] = visited++;
+                members.push_back(f);
+                on_stack[f] = true;
+            }
+            if (next < callees[f].size()) {
+                stack.back().second++;
+                auto c = callees[f][next];
+                if (index[c] == -1)
+                    stack.emplace_back(c, 0);
+                else if (on_stack[c])
+                    low[f] = std::min(low[f], index[c]);
+                continue;
+            }
+            stack.pop_back();
+            if (!stack.empty()) {
+                auto parent = stack.back().first;
+                low[parent] = std::min(low[parent], low[f]);
+            }
+            if (low[f] != index[f])
+                continue;
+            vector<int> scc;
+            int member;
+            do {
+                member = members.back();
+                members.pop_back();
+                on_stack[member] = false;
+                scc_of[member] = sccs.size();
+                scc.push_back(member);
+            } while (member != f);
+            std::sort(scc.begin(), scc.end());
+            is_recursive.push_back(scc.size() > 1 || std::binary_search(callees[f].begin(), callees[f].end(), f));
+            sccs.push_back(std::move(scc));
+        }
+    }
+
+    // heights bottom-up, depths top-down
+    const int scc_cnt = sccs.size();
+    vector<int> height(scc_cnt, 0), depth(scc_cnt, 0);
+    for (int s = 0; s < scc_cnt; s++) {
+        for (auto f : sccs[s]) {
+            for (auto c : callees[f]) {
+                if (scc_of[c] != s)
+                    height[s] = std::max(height[s], height[scc_of[c]] + 1);
+            }
+        }
+    }
+    for (int s = scc_cnt - 1; s >= 0; s--) {
+        for (auto f : sccs[s]) {
+            for (auto c : callers[f]) {
+                if (scc_of[c] != s)
+                    depth[s] = std::max(depth[s], depth[scc_of[c]] + 1);
+            }
+        }
+    }
+    for (int s = 0; s < scc_cnt; s++) {
+        if (height[s] >= by_height.size())
+            by_height.resize(height[s] + 1);
+        by_height[height[s]].push_back(s);
+        if (depth[s] >= by_depth.size())
+            by_depth.resize(depth[s] + 1);
+        by_depth[depth[s]].push_back(s);
+    }
+}
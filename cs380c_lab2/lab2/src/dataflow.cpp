@@ -0,0 +1,35 @@
+#include <algorithm>
+
+#include "dataflow.h"
+vector<int> reverse_postorder(const Function& func) {
+    const auto bb_cnt = func.basic_blocks.size();
+    vector<int> order;
+    order.reserve(bb_cnt);
+    vector<char> visited(bb_cnt, false);
+    // an explicit stack of (block, next successor to visit), deep CFGs would overflow recursion
+    vector<std::pair<int, size_t>> stack;
+    if (bb_cnt > 0) {
+        stack.emplace_back(0, 0);
+        visited[0] = true;
+    }
+    while (!stack.empty()) {
+        auto& [b, next] = stack.back();
+        const auto& succs = func.basic_blocks[b].successor_labels;
+        if (next < succs.size()) {
+            auto s = func.idx_of_bb.at(succs[next++]);
+            if (!visited[s]) {
+                visited[s] = true;
+                stack.emplace_back(s, 0);
+            }
+            continue;
+        }
+        order.push_back(b);
+        stack.pop_back();
+    }
+    std::reverse(order.begin(), order.end());
+    for (size_t b = 0; b < bb_cnt; b++) {
+        if (!visited[b])
+            order.push_back(b);
+    }
+    return order;
+}
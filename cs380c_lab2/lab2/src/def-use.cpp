@@ -0,0 +1,136 @@
+#include <algorithm>
+
+#include "ir.h"
+namespace {
+// Whether the operand reads an object: a value or an address (not a field offset)
+bool names_object(const Operand& operand) {
+    switch (operand.type) {
+        case Operand::Type::REG:
+        case Operand::Type::LOCAL_VARIABLE:
+        case Operand::Type::GLOBAL_VARIABLE:
+        case Operand::Type::PARAMETER:
+        case Operand::Type::LOCAL_ADDR:
+        case Operand::Type::GLOBAL_ADDR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// The operand slots an instruction reads
+size_t used_operand_cnt(const Instruction& inst) {
+    switch (inst.opcode.info().use) {
+        case Opcode::Use::USE_ALL:
+            return inst.operands.size();
+        case Opcode::Use::USE_FIRST:
+            return std::min<size_t>(inst.operands.size(), 1);
+        default:
+            return 0;
+    }
+}
+
+// Remove slot pos of the chain [start, start + cnt) by moving the last element
+// into it; returns the element moved, so its owner can record its new position
+template <typename T>
+const T* erase_from_chain(vector<T>& chain, uint32_t start, uint32_t& cnt, uint32_t pos) {
+    assert(pos >= start && pos < start + cnt);
+    --cnt;
+    if (pos == start + cnt)
+        return nullptr;
+    chain[pos] = chain[start + cnt];
+    return &chain[pos];
+}
+}  // namespace
+
+DefUse::DefUse(const Function& func) : label_0(func.basic_blocks.front().first_label()) {
+    auto object_of = [&](uint32_t symbol) {
+        auto [iter, inserted] = object_of_symbol.emplace(symbol, symbol_of_object.size());
+        if (inserted) {
+            symbol_of_object.push_back(symbol);
+            def_cnt.push_back(0);
+            use_cnt.push_back(0);
+        }
+        return iter->second;
+    };
+    // count the definitions and uses of every object, then lay the chains out by counting sort
+    for (uint32_t b = 0; b < func.basic_blocks.size(); b++) {
+        for (const auto& inst : func.basic_blocks[b].instructions) {
+            assert(inst.label - label_0 == object_of_def.size());
+            block_of_inst.push_back(b);
+            auto def = inst.get_def();
+            object_of_def.push_back(def == SymbolTable::NONE ? SymbolTable::NONE : object_of(def));
+            if (def != SymbolTable::NONE)
+                def_cnt[object_of_def.back()]++;
+            array<uint32_t, 2> objects = {SymbolTable::NONE, SymbolTable::NONE};
+            for (size_t k = 0; k < used_operand_cnt(inst); k++) {
+                if (names_object(inst.operands[k])) {
+                    objects[k] = object_of(inst.operands[k].symbol);
+                    use_cnt[objects[k]]++;
+                }
+            }
+            operand_objects.push_back(objects);
+        }
+    }
+    const auto object_cnt = symbol_of_object.size();
+    def_start.assign(object_cnt, 0);
+    use_start.assign(object_cnt, 0);
+    for (size_t o = 1; o < object_cnt; o++) {
+        def_start[o] = def_start[o - 1] + def_cnt[o - 1];
+        use_start[o] = use_start[o - 1] + use_cnt[o - 1];
+    }
+    if (object_cnt > 0) {
+        defs.resize(def_start.back() + def_cnt.back());
+        uses.resize(use_start.back() + use_cnt.back());
+    }
+    const auto inst_cnt = object_of_def.size();
+    def_pos.assign(inst_cnt, SymbolTable::NONE);
+    use_pos.assign(inst_cnt, {SymbolTable::NONE, SymbolTable::NONE});
+    std::fill(def_cnt.begin(), def_cnt.end(), 0);
+    std::fill(use_cnt.begin(), use_cnt.end(), 0);
+    for (uint32_t i = 0; i < inst_cnt; i++) {
+        if (auto o = object_of_def[i]; o != SymbolTable::NONE) {
+            def_pos[i] = def_start[o] + def_cnt[o]++;
+            defs[def_pos[i]] = i;
+        }
+        for (uint32_t k = 0; k < 2; k++) {
+            if (auto o = operand_objects[i][k]; o != SymbolTable::NONE) {
+                use_pos[i][k] = use_start[o] + use_cnt[o]++;
+                uses[use_pos[i][k]] = {i, k};
+            }
+        }
+    }
+}
+
+uint32_t DefUse::object(uint32_t symbol) const {
+    auto iter = object_of_symbol.find(symbol);
+    return iter == object_of_symbol.end() ? SymbolTable::NONE : iter->second;
+}
+
+void DefUse::erase_instruction(uint32_t inst) {
+    if (auto o = object_of_def[inst]; o != SymbolTable::NONE) {
+        if (auto moved = erase_from_chain(defs, def_start[o], def_cnt[o], def_pos[inst]))
+            def_pos[*moved] = def_pos[inst];
+        object_of_def[inst] = SymbolTable::NONE;
+        def_pos[inst] = SymbolTable::NONE;
+    }
+    for (size_t k = 0; k < 2; k++)
+        erase_use(inst, k);
+}
+
+void DefUse::erase_use(uint32_t inst, size_t k) {
+    auto o = operand_objects[inst][k];
+    if (o == SymbolTable::NONE)
+        return;
+    if (auto moved = erase_from_chain(uses, use_start[o], use_cnt[o], use_pos[inst][k]))
+        use_pos[moved->inst][moved->operand] = use_pos[inst][k];
+    operand_objects[inst][k] = SymbolTable::NONE;
+    use_pos[inst][k] = SymbolTable::NONE;
+}
+
+DefUse& Function::chains() {
+    if (!chains_valid) {
+        def_use = DefUse(*this);
+        chains_valid = true;
+    }
+    return def_use;
+}
@@ -0,0 +1,323 @@
+#include <algorithm>
+
+#include "ir.h"
+namespace {
+// Number the nodes of a forest in preorder, given the children of each node
+// and the roots: node n covers [first[n], last[n]]
+void number_preorder(const vector<vector<int>>& children, const vector<int>& roots, vector<int>& first, vector<int>& last) {
+    first.assign(children.size(), -1);
+    last.assign(children.size(), -1);
+    int next = 0;
+    vector<std::pair<int, size_t>> stack;
+    for (auto root : roots) {
+        stack.emplace_back(root, 0);
+        first[root] = next++;
+        while (!stack.empty()) {
+            auto& [n, child] = stack.back();
+            if (child < children[n].size()) {
+                auto c = children[n][child++];
+                first[c] = next++;
+                stack.emplace_back(c, 0);
+                continue;
+            }
+            last[n] = next - 1;
+            stack.pop_back();
+        }
+    }
+}
+}  // namespace
+
+DominatorTree::DominatorTree(const Function& func, bool post) {
+    const int bb_cnt = func.basic_blocks.size();
+    const int node_cnt = post ? bb_cnt + 1 : bb_cnt;
+    preds.resize(node_cnt);
+    succs.resize(node_cnt);
+    for (int b = 0; b < bb_cnt; b++) {
+        for (auto label : func.basic_blocks[b].successor_labels) {
+            int s = func.idx_of_bb.at(label);
+            if (post) {
+                succs[s].push_back(b);
+                preds[b].push_back(s);
+            } else {
+                succs[b].push_back(s);
+                preds[s].push_back(b);
+            }
+        }
+    }
+    root = 0;
+    if (post) {
+        root = bb_cnt;
+        for (int b = 0; b < bb_cnt; b++) {
+            if (func.basic_blocks[b].successor_labels.empty()) {
+                succs[root].push_back(b);
+                preds[b].push_back(root);
+            }
+        }
+    }
+
+    // reverse postorder of a depth-first walk from the root, as reverse_postorder
+    // walks the CFG, without the blocks it never reaches
+    rpo_number.assign(node_cnt, -1);
+    {
+        vector<char> visited(node_cnt, false);
+        vector<std::pair<int, size_t>> stack;
+        stack.emplace_back(root, 0);
+        visited[root] = true;
+        while (!stack.empty()) {
+            auto& [b, next] = stack.back();
+            if (next < succs[b].size()) {
+                auto s = succs[b][next++];
+                if (!visited[s]) {
+                    visited[s] = true;
+                    stack.emplace_back(s, 0);
+                }
+                continue;
+            }
+            rpo.push_back(b);
+            stack.pop_back();
+        }
+        std::reverse(rpo.begin(), rpo.end());
+    }
+    for (int i = 0; i < rpo.size(); i++)
+        rpo_number[rpo[i]] = i;
+
+    idom.assign(node_cnt, -1);
+    idom[root] = root;
+    auto intersect = [&](int a, int b) {
+        while (a != b) {
+            while (rpo_number[a] > rpo_number[b])
+                a = idom[a];
+            while (rpo_number[b] > rpo_number[a])
+                b = idom[b];
+        }
+        return a;
+    };
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 1; i < rpo.size(); i++) {
+            int b = rpo[i];
+            int new_idom = -1;
+            for (int p : preds[b]) {
+                if (idom[p] == -1)
+                    continue;
+                new_idom = new_idom == -1 ? p : intersect(p, new_idom);
+            }
+            if (idom[b] != new_idom) {
+                idom[b] = new_idom;
+                changed = true;
+            }
+        }
+    }
+
+    children.resize(node_cnt);
+    for (int b : rpo) {
+        if (b != root)
+            children[idom[b]].push_back(b);
+    }
+    number_preorder(children, {root}, first, last);
+    // a join point is in the frontier of every block from each predecessor up to its idom
+    frontier.resize(node_cnt);
+    for (int b : rpo) {
+        if (preds[b].size() < 2)
+            continue;
+        for (int p : preds[b]) {
+            if (!reachable(p))
+                continue;
+            for (int runner = p; runner != idom[b]; runner = idom[runner]) {
+                if (frontier[runner].empty() || frontier[runner].back() != b)
+                    frontier[runner].push_back(b);
+            }
+        }
+    }
+}
+
+LoopForest::LoopForest(const Function& func, const DominatorTree& dom) {
+    const int bb_cnt = func.basic_blocks.size();
+    loop_of.assign(bb_cnt, -1);
+
+    // Headers from the innermost out (by decreasing reverse postorder, as a
+    // header dominates the headers nested in it). Each body is walked
+    // backwards from the latches; a block already in a loop stands for the
+    // outermost loop found so far around it, through a union-find over the
+    // headers, so every edge is walked about once per nesting level it enters.
+    vector<int> outer(bb_cnt);  // union-find: a block's loop header so far, a header's enclosing header
+    for (int b = 0; b < bb_cnt; b++)
+        outer[b] = b;
+    auto find = [&](int b) {
+        while (outer[b] != b) {
+            outer[b] = outer[outer[b]];
+            b = outer[b];
+        }
+        return b;
+    };
+    vector<Loop> found;
+    vector<int> stack;
+    for (auto iter = dom.rpo.rbegin(); iter != dom.rpo.rend(); ++iter) {
+        const int h = *iter;
+        Loop loop{h, -1, 0};
+        for (int p : dom.preds[h]) {
+            if (dom.reachable(p) && dom.dominates(h, p))
+                loop.latches.push_back(p);
+        }
+        if (loop.latches.empty())
+            continue;
+        std::sort(loop.latches.begin(), loop.latches.end());
+        loop.latches.erase(std::unique(loop.latches.begin(), loop.latches.end()), loop.latches.end());
+        const int l = found.size();
+        loop_of[h] = l;
+        auto visit = [&](int b) {
+            int r = find(b);
+            if (r == h)
+                return;
+            if (loop_of[r] >= 0) {
+                // the outermost loop so far around b is nested in this one
+                found[loop_of[r]].parent = l;
+            } else {
+                loop_of[r] = l;
+            }
+            outer[r] = h;
+            stack.push_back(r);
+        };
+        for (int p : loop.latches)
+            visit(p);
+        while (!stack.empty()) {
+            int b = stack.back();
+            stack.pop_back();
+            for (int p : dom.preds[b]) {
+                if (dom.reachable(p))
+                    visit(p);
+            }
+        }
+        found.push_back(std::move(loop));
+    }
+
+    // renumber outer loops first and nest them
+    vector<int> number(found.size());
+    for (int i = 0; i < found.size(); i++)
+        number[i] = found.size() - 1 - i;
+    loops.resize(found.size());
+    for (int i = 0; i < found.size(); i++) {
+        auto& loop = loops[number[i]];
+        loop = std::move(found[i]);
+        if (loop.parent >= 0)
+            loop.parent = number[loop.parent];
+    }
+    for (auto& l : loop_of) {
+        if (l >= 0)
+            l = number[l];
+    }
+    for (int l = 0; l < loops.size(); l++) {
+        auto& loop = loops[l];
+        if (loop.parent < 0) {
+            loop.depth = 1;
+            roots.push_back(l);
+        } else {
+            loop.depth = loops[loop.parent].depth + 1;
+            loops[loop.parent].children.push_back(l);
+        }
+    }
+    number_preorder([&] {
+        vector<vector<int>> children(loops.size());
+        for (int l = 0; l < loops.size(); l++)
+            children[l] = loops[l].children;
+        return children;
+    }(), roots, first, last);
+
+    // every block belongs to its innermost loop and the loops around it
+    for (int b = 0; b < bb_cnt; b++) {
+        for (int l = loop_of[b]; l >= 0; l = loops[l].parent)
+            loops[l].blocks.push_back(b);
+    }
+    for (int l = 0; l < loops.size(); l++) {
+        auto& loop = loops[l];
+        for (int b : loop.blocks) {
+            for (int s : dom.succs[b]) {
+                if (!contains(l, s))
+                    loop.exits.push_back(s);
+            }
+        }
+        std::sort(loop.exits.begin(), loop.exits.end());
+        loop.exits.erase(std::unique(loop.exits.begin(), loop.exits.end()), loop.exits.end());
+    }
+}
+
+const DominatorTree& Function::dominators() {
+    if (!dominators_valid) {
+        dom_tree = DominatorTree(*this);
+        dominators_valid = true;
+    }
+    return dom_tree;
+}
+
+const DominatorTree& Function::post_dominators() {
+    if (!post_dominators_valid) {
+        post_dom_tree = DominatorTree(*this, true);
+        post_dominators_valid = true;
+    }
+    return post_dom_tree;
+}
+
+const LoopForest& Function::loops() {
+    if (!loops_valid) {
+        loop_forest = LoopForest(*this, dominators());
+        loops_valid = true;
+    }
+    return loop_forest;
+}
+
+string Function::cfg_analysis() {
+    const auto& dom = dominators();
+    const auto& post_dom = post_dominators();
+    const auto& forest = loops();
+    auto label = [&](int b) { return basic_blocks[b].first_label(); };
+    std::stringstream tmp;
+    tmp << cfg();
+    // block -> its immediate dominator; nothing for the entry and unreachable blocks
+    tmp << "Dominators:" << std::endl;
+    for (int b = 0; b < basic_blocks.size(); b++) {
+        tmp << label(b) << " ->";
+        if (dom.reachable(b) && b != dom.root)
+            tmp << " " << label(dom.idom[b]);
+        tmp << std::endl;
+    }
+    // block -> its immediate post-dominator, "exit" for the virtual exit
+    tmp << "Post-dominators:" << std::endl;
+    for (int b = 0; b < basic_blocks.size(); b++) {
+        tmp << label(b) << " ->";
+        if (post_dom.reachable(b)) {
+            if (post_dom.idom[b] == post_dom.root)
+                tmp << " exit";
+            else
+                tmp << " " << label(post_dom.idom[b]);
+        }
+        tmp << std::endl;
+    }
+    tmp << "Dominance frontiers:" << std::endl;
+    for (int b = 0; b < basic_blocks.size(); b++) {
+        auto frontier = dom.frontier[b];
+        std::sort(frontier.begin(), frontier.end());
+        tmp << label(b) << " ->";
+        for (int f : frontier)
+            tmp << " " << label(f);
+        tmp << std::endl;
+    }
+    tmp << "Loops:" << std::endl;
+    auto labels = [&](const char* name, const vector<int>& blocks) {
+        tmp << " " << name;
+        for (int b : blocks)
+            tmp << " " << label(b);
+    };
+    for (const auto& loop : forest.loops) {
+        tmp << label(loop.header) << ": depth " << loop.depth << ",";
+        if (loop.parent >= 0)
+            tmp << " parent " << label(forest.loops[loop.parent].header) << ",";
+        labels("latches", loop.latches);
+        tmp << ",";
+        labels("exits", loop.exits);
+        tmp << ",";
+        labels("blocks", loop.blocks);
+        tmp << std::endl;
+    }
+    return tmp.str();
+}
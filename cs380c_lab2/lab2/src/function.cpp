@@ -1,13 +1,14 @@
 #include <algorithm>
 
+#include "dataflow.h"
 #include "ir.h"
-void Function::scan_local_variables(vector<Instruction>& instrs) {
-    for (const auto& inst : instrs) {
-        for (const auto& operand : inst.operands) {
+void Function::scan_local_variables(const Instruction* first, const Instruction* last, const SymbolTable& symbols) {
+    for (auto inst = first; inst != last; ++inst) {
+        for (const auto& operand : inst->operands) {
             if (operand.type == Operand::Type::LOCAL_VARIABLE) {
-                this->local_variables.emplace_back(operand.variable_name, operand.offset);
+                this->local_variables.emplace_back(symbols.name(operand.symbol), operand.offset);
             } else if (operand.type == Operand::Type::LOCAL_ADDR) {
-                this->local_variables.emplace_back(operand.variable_name, operand.offset);
+                this->local_variables.emplace_back(symbols.name(operand.symbol), operand.offset);
             }
         }
     }
@@ -29,11 +30,11 @@ void Function::scan_local_variables(vector<Instruction>& instrs) {
     std::reverse(local_variables.begin(), local_variables.end());
 }
 
-void Function::scan_parameters(vector<Instruction>& instrs) {
-    for (const auto& inst : instrs) {
-        for (const auto& operand : inst.operands) {
+void Function::scan_parameters(const Instruction* first, const Instruction* last, const SymbolTable& symbols) {
+    for (auto inst = first; inst != last; ++inst) {
+        for (const auto& operand : inst->operands) {
             if (operand.type == Operand::Type::PARAMETER) {
-                this->params.emplace_back(operand.variable_name, operand.offset);
+                this->params.emplace_back(symbols.name(operand.symbol), operand.offset);
             }
         }
     }
@@ -48,27 +49,27 @@ void Function::scan_parameters(vector<Instruction>& instrs) {
     std::reverse(params.begin(), params.end());
 }
 
-Function::Function(vector<Instruction>& instrs, bool _is_main)
-    : is_main(_is_main), id(0), constant_propagated_cnt(0), statement_eliminated_cnt(0) {
-    assert(instrs[0].opcode.type == Opcode::Type::ENTER);
-    this->local_var_size = instrs[0].operands[0].constant;
-    this->id = instrs[0].label;
-    assert(instrs.back().opcode.type == Opcode::Type::RET);
-    this->param_size = instrs.back().operands[0].constant;
-    this->scan_local_variables(instrs);
-    this->scan_parameters(instrs);
-    this->scan_block_leaders(instrs);
-
-    vector<Instruction> tmp = {};
-    for (auto& inst : instrs) {
-        if (inst.is_block_leader && !tmp.empty()) {
-            basic_blocks.emplace_back(tmp);
-            tmp = {};
+Function::Function(Instruction* first, Instruction* last, const SymbolTable& symbols,
+                   std::pmr::memory_resource* resource, bool _is_main)
+    : is_main(_is_main), basic_blocks(resource), idx_of_bb(resource), id(0), constant_propagated_cnt(0), statement_eliminated_cnt(0) {
+    assert(first->opcode.type == Opcode::Type::ENTER);
+    this->local_var_size = first->operands[0].constant;
+    this->id = first->label;
+    assert((last - 1)->opcode.type == Opcode::Type::RET);
+    this->param_size = (last - 1)->operands[0].constant;
+    this->scan_local_variables(first, last, symbols);
+    this->scan_parameters(first, last, symbols);
+    this->scan_block_leaders(first, last);
+
+    basic_blocks.reserve(std::count_if(first, last, [](const Instruction& inst) { return inst.is_block_leader; }));
+    auto leader = first;
+    for (auto inst = first + 1; inst != last; ++inst) {
+        if (inst->is_block_leader) {
+            basic_blocks.emplace_back(leader, inst, resource);
+            leader = inst;
         }
-        tmp.push_back(inst);
     }
-    if (!tmp.empty())
-        basic_blocks.emplace_back(tmp);
+    basic_blocks.emplace_back(leader, last, resource);
 
     for (int i = 0; i < basic_blocks.size(); i++) {
         idx_of_bb[basic_blocks[i].first_label()] = i;
@@ -99,7 +100,7 @@ Function::Function(vector<Instruction>& instrs, bool _is_main)
 #endif
 }
 
-string Function::ccode() const {
+string Function::ccode(const SymbolTable& symbols, bool structured) const {
     std::stringstream tmp;
     if (is_main) {
         tmp << "void main(";
@@ -124,17 +125,32 @@ string Function::ccode() const {
         tmp << std::endl;
     }
 
-    for (auto& bb : basic_blocks) {
-        tmp << bb.ccode() << std::endl;
+    auto regs = allocate_registers(symbols);
+    if (regs.slot_cnt > 0) {
+        tmp << "  long ";
+        for (int i = 0; i < regs.slot_cnt; i++)
+            tmp << (i > 0 ? ", " : "") << regs.prefix << i;
+        tmp << ";" << std::endl;
+    }
+
+    if (structured) {
+        tmp << structured_ccode(symbols, regs);
+    } else {
+        // the arguments of the call being emitted
+        vector<string> args;
+        for (auto& bb : basic_blocks) {
+            tmp << bb.ccode(symbols, regs, args) << std::endl;
+        }
     }
 
     tmp << "}";
     return tmp.str();
 }
 
-void Function::scan_block_leaders(vector<Instruction>& instrs) {
-    const int n = instrs.size();
-    instrs.front().is_block_leader = true;
+void Function::scan_block_leaders(Instruction* first, Instruction* last) {
+    const int n = last - first;
+    auto instrs = first;
+    instrs[0].is_block_leader = true;
     for (int i = 0; i < n; i++) {
         if (instrs[i].is_branch()) {
             // a branch instruction cannot be the last instruction of a function
@@ -146,7 +162,7 @@ void Function::scan_block_leaders(vector<Instruction>& instrs) {
             //the target instruction must be in the same function
             assert(target_index >= 0 && target_index < n);
             assert(instrs[target_index].label == target_label);
-            instrs[target_index].predecessor_labels.push_back(own_label);
+            instrs[target_index].is_branch_target = true;
             instrs[target_index].is_block_leader = true;
         } else if (instrs[i].opcode.type == Opcode::Type::CALL) {
             // the last instruction must be a ret
@@ -158,17 +174,17 @@ void Function::scan_block_leaders(vector<Instruction>& instrs) {
 #ifdef BASIC_LEADER_DEBUG
     std::cout << "basic block leaders:" << std::endl;
     std::cout << "      ";
-    for (auto& inst : instrs) {
-        if (inst.is_block_leader)
-            std::cout << inst.label << " ";
+    for (auto inst = first; inst != last; ++inst) {
+        if (inst->is_block_leader)
+            std::cout << inst->label << " ";
     }
     std::cout << std::endl;
 #endif
 }
-string Function::icode() const {
+string Function::icode(const SymbolTable& symbols) const {
     std::stringstream tmp;
     for (auto& bb : basic_blocks) {
-        tmp << bb.icode();
+        tmp << bb.icode(symbols);
     }
     return tmp.str();
 }
@@ -186,271 +202,408 @@ string Function::cfg() const {
     }
     return tmp.str();
 }
-void Function::scp() {
-    vector<string> object_def_by_inst{};
-    // The index of all instructions in object_def_by_inst : label - label_0
-    const auto label_0 = basic_blocks.front().first_label();
-    for (const auto& bb : basic_blocks) {
+namespace {
+// Reaching definitions and the constants they carry, as scp uses them.
+// Folding and constant substitution never add or remove a definition, so
+// the gen and kill sets and the solution stay valid for every round of
+// scp_peephole; only which definitions are constant changes between rounds.
+// The definitions are the instructions, indexed as in the chains, followed
+// by one pseudo-definition on entry per entry constant of the context, and
+// one per global the function uses, made by every call that may write it.
+class ReachingConstants {
+   private:
+    Function& func;
+    DefUse& chains;
+    DataflowResult flow;
+    size_t inst_cnt;
+    vector<uint32_t> entry_objects;  // the object of each pseudo-definition on entry
+    vector<uint32_t> call_objects;   // and of each pseudo-definition by calls
+    vector<char> is_constant_def;
+    vector<long long> const_val_of_def;
+    vector<char> is_global;  // per object, whether it is a global variable
+    // With a context, the block walk follows moves too and substitutes into
+    // every operand read by value; lab2's walk only visits arithmetic
+    bool follow_moves;
+
+    uint32_t object_of(size_t def) const {
+        if (def < inst_cnt)
+            return chains.object_of_def[def];
+        if (def < inst_cnt + entry_objects.size())
+            return entry_objects[def - inst_cnt];
+        return call_objects[def - inst_cnt - entry_objects.size()];
+    }
+    // The objects that hold a constant on entry to block b
+    unordered_map<uint32_t, long long> constants_in(int b) const;
+
+   public:
+    ReachingConstants(Function& func, const ScpContext* context);
+    // Refresh whether definition def (an instruction index) is constant; true if it just became one
+    bool update(uint32_t def);
+    // Substitute the constants reaching block b into its arithmetic instructions
+    // (every instruction when following moves), appending the index of every instruction changed to touched
+    void propagate(int b, vector<uint32_t>& touched);
+    // Append the constants passed at every call of the function to calls
+    void call_sites(vector<CallSite>& calls) const;
+};
+
+ReachingConstants::ReachingConstants(Function& func, const ScpContext* context)
+    : func(func), chains(func.chains()), inst_cnt(chains.object_of_def.size()), follow_moves(context) {
+    // Instructions are indexed label - label_0, as in the chains
+    const auto& object_def_by_inst = chains.object_of_def;
+    const auto label_0 = chains.label_0;
+
+    is_global.assign(chains.object_cnt(), false);
+    for (const auto& bb : func.basic_blocks) {
         for (const auto& inst : bb.instructions) {
-            object_def_by_inst.push_back(inst.get_def());
+            for (const auto& operand : inst.operands) {
+                if (operand.type == Operand::Type::GLOBAL_VARIABLE)
+                    is_global[chains.object(operand.symbol)] = true;
+            }
+        }
+    }
+    // the entry constants of the function, in symbol order so that the
+    // numbering does not depend on the hash map
+    vector<long long> entry_values;
+    if (context) {
+        vector<std::pair<uint32_t, long long>> entry(context->entry_constants.begin(), context->entry_constants.end());
+        std::sort(entry.begin(), entry.end());
+        for (auto [symbol, value] : entry) {
+            auto object = chains.object(symbol);
+            if (object == SymbolTable::NONE)
+                continue;
+            entry_objects.push_back(object);
+            entry_values.push_back(value);
         }
     }
 
-    // gens,kills,globals set of basicblocks;(inst label)
+    // What a call leaves in a global it may write is unknown: a definition
+    // that is never constant, so that a constant from a path around the call
+    // does not reach past it alone
+    vector<uint32_t> call_def_of(chains.object_cnt(), SymbolTable::NONE);
+    for (uint32_t object = 0; object < is_global.size(); object++) {
+        if (is_global[object]) {
+            call_def_of[object] = inst_cnt + entry_objects.size() + call_objects.size();
+            call_objects.push_back(object);
+        }
+    }
+
+    // gens,kills,globals set of basicblocks, indexed by label - label_0
     // If there is a function call inside the basic block
     // F(x) = (GEN(B) - GLOBALS(B)) U (x - KILL(B))
     // else global will be empty
-    vector<unordered_set<int>> gens, kills, globals;
-    for (auto& bb : basic_blocks) {
-        gens.emplace_back();
-        auto& gen = gens.back();
-        kills.emplace_back();
-        auto& kill = kills.back();
-        globals.emplace_back();
-        auto& global = globals.back();
+    const auto def_cnt = inst_cnt + entry_objects.size() + call_objects.size();
+    auto bb_cnt = func.basic_blocks.size();
+    vector<BitVector> gens(bb_cnt, BitVector(def_cnt)), kills(bb_cnt, BitVector(def_cnt));
+    is_constant_def.assign(def_cnt, false);
+    const_val_of_def.assign(def_cnt, 0);
+    const bool know_mod = context && context->mod;
+    for (int b = 0; b < bb_cnt; b++) {
+        auto& bb = func.basic_blocks[b];
+        auto& gen = gens[b];
+        auto& kill = kills[b];
+        BitVector global(def_cnt);
         bool consider_global = bb.instructions.back().opcode.type == Opcode::Type::CALL;
+        // With mod summaries, GLOBALS(B) and the kills of the call only cover
+        // the globals the callee may write; null: it may write any
+        const vector<uint32_t>* mod = nullptr;
+        if (consider_global && know_mod) {
+            auto iter = context->mod->find(bb.instructions.back().operands[0].function_id);
+            if (iter != context->mod->end())
+                mod = &iter->second;
+        }
+        auto may_write = [&](uint32_t symbol) { return !mod || std::binary_search(mod->begin(), mod->end(), symbol); };
         for (auto& inst : bb.instructions) {
             if (inst.is_def()) {
-                gen.insert(inst.label);
-                auto object_def = inst.get_def();
                 auto own_idx = inst.label - label_0;  // the index of this instruction in object_def_by_inst
-                for (int i = 0; i < object_def_by_inst.size(); i++) {
-                    if (i == own_idx)
-                        continue;
-                    if (object_def_by_inst[i] == object_def)
-                        kill.insert(i + label_0);
+                gen.set(own_idx);
+                // every other definition of the same object
+                for (auto i : chains.defs_of(object_def_by_inst[own_idx])) {
+                    if (i != own_idx)
+                        kill.set(i);
                 }
+                if (call_def_of[object_def_by_inst[own_idx]] != SymbolTable::NONE)
+                    kill.set(call_def_of[object_def_by_inst[own_idx]]);
                 // Only the move instruction will def global variables
-                if (consider_global && inst.opcode.type == Opcode::Type::MOVE && inst.operands.back().type == Operand::Type::GLOBAL_VARIABLE) {
-                    global.insert(inst.label);
+                if (consider_global && inst.opcode.type == Opcode::Type::MOVE && inst.operands.back().type == Operand::Type::GLOBAL_VARIABLE &&
+                    may_write(inst.operands.back().symbol)) {
+                    global.set(own_idx);
                 }
+                update(own_idx);
             }
         }
-    }
-    /*
-    for(int i=0;i<basic_blocks.size();i++){
-        std::cout<<"gen of bb "<<i<<": ";
-        for(auto j:gens[i]){
-            std::cout<<" "<<j;
-        }
-        std::cout<<std::endl;
-
-        std::cout<<"kill of bb "<<i<<": ";
-        for(auto j:kills[i]){
-            std::cout<<" "<<j;
-        }
-        std::cout<<std::endl;
-    }
-*/
-    auto bb_cnt = basic_blocks.size();
-    vector<unordered_set<int>> ins(bb_cnt), outs(bb_cnt);  // IN set and OUT set of basic blocks
-    deque<int> changed;                                    //blocks changed in the last iteration
-    for (auto i = 0; i < bb_cnt; i++) {
-        changed.push_back(i);
-    }
-
-    while (!changed.empty()) {
-        auto n = changed.front();
-        changed.pop_front();
-        ins[n].clear();
-        //std::cout<<"predecessors of bb "<<n<<" :"<<basic_blocks[n].predecessor_labels.size();
-        for (auto pre_label : basic_blocks[n].predecessor_labels) {
-            ins[n].insert(outs[idx_of_bb[pre_label]].begin(), outs[idx_of_bb[pre_label]].end());
-            // std::cout<<" "<<pre_label;
-        }
-        //std::cout<<std::endl;
-
-        auto out_n_copy = outs[n];
-        outs[n].clear();
-        // out = gen-global
-        for (auto i : gens[n]) {
-            if (globals[n].count(i) == 0)
-                outs[n].insert(i);
-        }
-        // out = out \cup (in-kill)
-        for (auto i : ins[n]) {
-            if (kills[n].count(i) == 0)
-                outs[n].insert(i);
-        }
-        /*
-        std::cout << "size of in " << n <<" :"<< ins[n].size() << std::endl;
-        std::cout << "size of out " << n <<" :"<< outs[n].size() << std::endl;
-        */
-        // if out changed, successor basic blocks' out need to be recomputed
-        if (out_n_copy != outs[n]) {
-            for (auto s : basic_blocks[n].successor_labels) {
-                changed.push_back(idx_of_bb[s]);
+        gen.subtract(global);
+        // the call kills every definition of the globals it may write, made
+        // before the block too (without summaries, of every global), and
+        // makes its own
+        if (consider_global) {
+            for (uint32_t object = 0; object < is_global.size(); object++) {
+                if (!is_global[object] || !may_write(chains.symbol(object)))
+                    continue;
+                gen.set(call_def_of[object]);
+                for (auto i : chains.defs_of(object))
+                    kill.set(i);
+                for (size_t k = 0; k < entry_objects.size(); k++) {
+                    if (entry_objects[k] == object)
+                        kill.set(inst_cnt + k);
+                }
             }
-            sort(changed.begin(), changed.end());
-            auto iter = unique(changed.begin(), changed.end());
-            changed.erase(iter, changed.end());
         }
     }
-    unordered_map<long long, long long> const_val_of_def;
-    for (const auto& bb : basic_blocks) {
-        for (const auto& inst : bb.instructions) {
-            if (inst.is_constant_def()) {
-                const_val_of_def[inst.label] = inst.const_def_val();
-                // std::cout << "const val of def " << inst.label << " is " << inst.const_def_val() << std::endl;
-            }
-        }
+    // a pseudo-definition reaches the entry and is killed by every definition of its object
+    BitVector boundary(def_cnt);
+    for (size_t k = 0; k < entry_objects.size(); k++) {
+        auto def = inst_cnt + k;
+        boundary.set(def);
+        is_constant_def[def] = true;
+        const_val_of_def[def] = entry_values[k];
+        for (auto i : chains.defs_of(entry_objects[k]))
+            kills[chains.block_of_inst[i]].set(def);
     }
-    for (int i = 0; i < basic_blocks.size(); i++) {
-        const auto& in = ins[i];
-        unordered_set<string> non_constant_variable;
-        unordered_map<string, long long> constant_variable;
-        for (auto j : in) {
-            const auto& variable_name = object_def_by_inst[j - label_0];  //the variable name defed by definition i
-            assert(variable_name.size() > 0);
-            if (non_constant_variable.count(variable_name) > 0)
-                continue;
-            if (const_val_of_def.count(j) == 0) {  //this def does not generate constant value
-                non_constant_variable.insert(variable_name);
-                constant_variable.erase(variable_name);
+
+    // reaching definitions: IN = U OUT(pred)
+    flow = solve_dataflow<Direction::FORWARD, Meet::UNION>(func, def_cnt, GenKill{gens, kills},
+                                                           entry_objects.empty() ? nullptr : &boundary);
+    func.dataflow_iterations += flow.iterations;
+}
+
+bool ReachingConstants::update(uint32_t def) {
+    if (is_constant_def[def])
+        return false;
+    const auto& bb = func.basic_blocks[chains.block_of_inst[def]];
+    const auto& inst = bb.instructions[chains.label_0 + def - bb.first_label()];
+    if (!inst.is_constant_def())
+        return false;
+    is_constant_def[def] = true;
+    const_val_of_def[def] = inst.const_def_val();
+    return true;
+}
+
+unordered_map<uint32_t, long long> ReachingConstants::constants_in(int i) const {
+    unordered_set<uint32_t> non_constant_variable;
+    unordered_map<uint32_t, long long> constant_variable;
+    flow.ins[i].for_each([&](size_t j) {
+        const auto variable_name = object_of(j);  //the variable defed by definition j
+        assert(variable_name != SymbolTable::NONE);
+        if (non_constant_variable.count(variable_name) > 0)
+            return;
+        if (!is_constant_def[j]) {  //this def does not generate constant value
+            non_constant_variable.insert(variable_name);
+            constant_variable.erase(variable_name);
+        } else {
+            auto constant_value = const_val_of_def[j];  //the definition's const value
+            if (constant_variable.count(variable_name) == 0) {
+                constant_variable[variable_name] = constant_value;
             } else {
-                auto constant_value = const_val_of_def[j];  //the definition's const value
-                if (constant_variable.count(variable_name) == 0) {
-                    constant_variable[variable_name] = constant_value;
-                } else {
-                    if (constant_variable[variable_name] != constant_value) {
-                        constant_variable.erase(variable_name);
-                        non_constant_variable.insert(variable_name);
-                    }
+                if (constant_variable[variable_name] != constant_value) {
+                    constant_variable.erase(variable_name);
+                    non_constant_variable.insert(variable_name);
                 }
             }
         }
+    });
+    return constant_variable;
+}
 
-        /*
-        for (auto& [key, value] : constant_variable) {
-            std::cout << "bb " << i << " " << key << " has value " << value << std::endl;
-        }*/
+void ReachingConstants::propagate(int i, vector<uint32_t>& touched) {
+    const auto& object_def_by_inst = chains.object_of_def;
+    const auto label_0 = chains.label_0;
+    auto constant_variable = constants_in(i);
 
-        for (auto& inst : basic_blocks[i].instructions) {
-            if (!inst.is_arithmetic()) {
+    /*
+    for (auto& [key, value] : constant_variable) {
+        std::cout << "bb " << i << " " << key << " has value " << value << std::endl;
+    }*/
+
+    for (auto& inst : func.basic_blocks[i].instructions) {
+        if (!inst.is_arithmetic() && !follow_moves) {
+            // not followed, but a move or load still ends the constant reaching the block
+            if (inst.is_def())
+                constant_variable.erase(object_def_by_inst[inst.label - label_0]);
+            continue;
+        }
+        for (int k = 0; k < inst.operands.size(); k++) {
+            auto& operand = inst.operands[k];
+            if (!operand.is_value())
                 continue;
-            }
-            for (auto& operand : inst.operands) {
-                auto op_variable_name = operand.icode();
-                if (constant_variable.count(op_variable_name) > 0) {
-                    //std::cout << "//" << inst.icode() << std::endl;
-                    operand.type = Operand::Type::CONSTANT;
-                    operand.constant = constant_variable[op_variable_name];
-                    constant_propagated_cnt++;
-                    //std::cout << "//" << inst.icode() << std::endl;
-                }
-            }
-            if (inst.is_def()) {
-                auto tmp_name = object_def_by_inst[inst.label - label_0];
-                assert(tmp_name == inst.get_def());
-                if (constant_variable.count(tmp_name) != 0) {
-                    if (!inst.is_constant_def()) {
-                        constant_variable.erase(tmp_name);
-                        //std::cout << "//erased " << tmp_name << std::endl;
-                    } else {
-                        if (constant_variable.count(inst.get_def()) > 0) {
-                            if (inst.const_def_val() != constant_variable[inst.get_def()]) {
-                                constant_variable.erase(tmp_name);
-                                //std::cout << "//erased " << tmp_name << std::endl;
-                            }
-                        }
-                    }
-                } else if (inst.is_constant_def()) {
-                    constant_variable[inst.get_def()] = inst.const_def_val();
-                }
+            auto op_variable_name = chains.operand_object(inst.label - label_0, k);
+            if (constant_variable.count(op_variable_name) > 0) {
+                //std::cout << "//" << inst.icode() << std::endl;
+                chains.erase_use(inst.label - label_0, k);
+                operand.type = Operand::Type::CONSTANT;
+                operand.symbol = SymbolTable::NONE;
+                operand.constant = constant_variable[op_variable_name];
+                func.constant_propagated_cnt++;
+                touched.push_back(inst.label - label_0);
+                //std::cout << "//" << inst.icode() << std::endl;
             }
         }
-    }
-}
-
-void Function::scp_peephole() {
-    bool flag = false;
-    while (true) {
-        for (auto& bb : basic_blocks) {
-            for (auto& inst : bb.instructions) {
-                inst.peephole2();
-                inst.peephole3();
-            }
+        if (inst.is_def()) {
+            auto tmp_name = object_def_by_inst[inst.label - label_0];
+            assert(chains.symbol(tmp_name) == inst.get_def());
+            if (inst.is_constant_def())
+                constant_variable[tmp_name] = inst.const_def_val();
+            else
+                constant_variable.erase(tmp_name);
         }
-        if (flag)
-            break;
-        auto old_cnt = constant_propagated_cnt;
-        scp();
-        if (constant_propagated_cnt == old_cnt)
-            flag = true;
     }
 }
 
-// Only consider local variables and virtual registers
-void Function::dse() {
-    vector<unordered_set<string>> defs, uses;
-    for (const auto& bb : basic_blocks) {
-        defs.emplace_back();
-        uses.emplace_back();
-        auto& def = defs.back();
-        auto& use = uses.back();
+void ReachingConstants::call_sites(vector<CallSite>& calls) const {
+    const auto label_0 = chains.label_0;
+    for (int b = 0; b < func.basic_blocks.size(); b++) {
+        const auto& bb = func.basic_blocks[b];
+        if (bb.instructions.back().opcode.type != Opcode::Type::CALL)
+            continue;
+        // Unlike propagate, follow every move and assign of the block, so that
+        // a global stored or an argument loaded just before the call is seen
+        auto constants = constants_in(b);
+        auto value_of = [&](const Instruction& inst) -> std::optional<long long> {
+            const auto& operand = inst.operands[0];
+            if (operand.type == Operand::Type::CONSTANT)
+                return operand.constant;
+            if (!operand.is_value())
+                return std::nullopt;
+            auto iter = constants.find(chains.operand_object(inst.label - label_0, 0));
+            if (iter == constants.end())
+                return std::nullopt;
+            return iter->second;
+        };
+        CallSite site;
         for (const auto& inst : bb.instructions) {
-            for (auto& u : inst.get_use_dse()) {
-                if (u.size() == 0)
-                    continue;
-                if (def.count(u) == 0)
-                    use.insert(u);
+            if (inst.opcode.type == Opcode::Type::PARAM) {
+                site.args.push_back(value_of(inst));
+            } else if (inst.opcode.type == Opcode::Type::CALL) {
+                site.callee = inst.operands[0].function_id;
+                for (auto [object, value] : constants) {
+                    if (is_global[object])
+                        site.globals[chains.symbol(object)] = value;
+                }
+            } else if (inst.is_def()) {
+                auto object = chains.object_of_def[inst.label - label_0];
+                std::optional<long long> value;
+                if (inst.opcode.type == Opcode::Type::MOVE || inst.opcode.type == Opcode::Type::ASSIGN)
+                    value = value_of(inst);
+                if (value)
+                    constants[object] = *value;
+                else
+                    constants.erase(object);
             }
-            auto d = inst.get_def_dse();
-            if (d.size() == 0)
-                continue;
-            if (use.count(d) == 0)
-                def.insert(d);
         }
+        calls.push_back(std::move(site));
     }
+}
+}  // namespace
 
-    auto bb_cnt = basic_blocks.size();
-    vector<unordered_set<string>> ins(bb_cnt), outs(bb_cnt);
-    unordered_set<int> changed;
-    for (int i = 0; i < bb_cnt; i++) {
-        changed.insert(i);
-    }
-    while (!changed.empty()) {
-        auto n = *changed.begin();
-        changed.erase(n);
-        outs[n].clear();
-        for (auto s : basic_blocks[n].successor_labels) {
-            int idx_s = idx_of_bb[s];
-            outs[n].insert(ins[idx_s].begin(), ins[idx_s].end());
-        }
-        auto ins_n_copy = ins[n];
-        ins[n].clear();
-
-        //IN = use \cup (Out -def)
-        ins[n].insert(uses[n].begin(), uses[n].end());
+void Function::scp() {
+    ReachingConstants reaching(*this, nullptr);
+    vector<uint32_t> touched;
+    for (int i = 0; i < basic_blocks.size(); i++)
+        reaching.propagate(i, touched);
+}
 
-        for (auto& s : outs[n]) {
-            if (defs[n].count(s) == 0)
-                ins[n].insert(s);
+// Incremental: after the first round, only the instructions scp changed are
+// folded again, and only the blocks that read a definition which became
+// constant are propagated into again, over the same reaching definitions
+void Function::scp_peephole(const ScpContext* context, vector<CallSite>* calls) {
+    for (auto& bb : basic_blocks) {
+        for (auto& inst : bb.instructions) {
+            inst.peephole2();
+            inst.peephole3();
         }
-        if (ins[n] != ins_n_copy) {
-            for (auto p : basic_blocks[n].predecessor_labels) {
-                auto idx_p = idx_of_bb[p];
-                changed.insert(idx_p);
+    }
+    ReachingConstants reaching(*this, context);
+    auto& chains = this->chains();
+    vector<uint32_t> touched;
+    for (int i = 0; i < basic_blocks.size(); i++)
+        reaching.propagate(i, touched);
+
+    vector<char> is_dirty(basic_blocks.size(), false);
+    vector<int> dirty;
+    while (!touched.empty()) {
+        for (auto idx : touched) {
+            auto& bb = basic_blocks[chains.block_of_inst[idx]];
+            auto& inst = bb.instructions[chains.label_0 + idx - bb.first_label()];
+            inst.peephole2();
+            inst.peephole3();
+            if (!reaching.update(idx))
+                continue;
+            for (const auto& use : chains.uses_of(chains.object_of_def[idx])) {
+                auto b = chains.block_of_inst[use.inst];
+                if (!is_dirty[b]) {
+                    is_dirty[b] = true;
+                    dirty.push_back(b);
+                }
             }
         }
+        touched.clear();
+        std::sort(dirty.begin(), dirty.end());
+        for (auto b : dirty) {
+            is_dirty[b] = false;
+            reaching.propagate(b, touched);
+        }
+        dirty.clear();
     }
+    if (calls)
+        reaching.call_sites(*calls);
+}
 
-    for (int i = 0; i < basic_blocks.size(); i++) {
-        auto& bb = basic_blocks[i];
-        auto live = outs[i];
+// Only consider local variables and virtual registers. Liveness is strong:
+// a statement that is removed reads nothing, so whatever feeds only removed
+// statements is removed too, even around a loop, like the update of an
+// induction variable nothing else reads any more
+void Function::dse() {
+    // variables and registers are the objects of the chains
+    auto& chains = this->chains();
+    const auto label_0 = chains.label_0;
+    const auto var_cnt = chains.object_cnt();
+    auto uses_of = [&](const Instruction& inst) {
+        auto res = inst.get_use_dse();
+        for (size_t k = 0; k < 2; k++) {
+            if (res[k] != SymbolTable::NONE)
+                res[k] = chains.operand_object(inst.label - label_0, k);
+        }
+        return res;
+    };
+    auto def_of = [&](const Instruction& inst) {
+        return inst.get_def_dse() == SymbolTable::NONE ? SymbolTable::NONE : chains.object_of_def[inst.label - label_0];
+    };
+    // Walk the block backwards from live, calling dead on each statement whose definition is not live
+    auto walk = [&](BasicBlock& bb, BitVector& live, auto dead) {
         for (auto iter = bb.instructions.rbegin(); iter != bb.instructions.rend(); ++iter) {
-            auto& inst = *iter;
-            for (auto& u : inst.get_use_dse()) {
-                if (u.size() > 0)
-                    live.insert(u);
+            auto d = def_of(*iter);
+            if (d != SymbolTable::NONE) {
+                if (!live.test(d)) {
+                    dead(*iter);
+                    continue;
+                }
+                live.reset(d);
             }
-            auto def_of_inst = inst.get_def_dse();
-            if (def_of_inst.size() == 0)
-                continue;
-            if(live.count(def_of_inst)==0){
-                inst.to_nop();
-                statement_eliminated_cnt++;
+            for (auto u : uses_of(*iter)) {
+                if (u != SymbolTable::NONE)
+                    live.set(u);
             }
         }
+    };
+
+    // IN = what the statements kept read, backwards from OUT
+    BitVector live(var_cnt);
+    auto transfer = [&](size_t b, const BitVector& out, BitVector& in) {
+        live = out;
+        walk(basic_blocks[b], live, [](Instruction&) {});
+        if (live == in)
+            return false;
+        std::swap(live, in);
+        return true;
+    };
+    auto flow = solve_dataflow<Direction::BACKWARD, Meet::UNION>(*this, var_cnt, transfer);
+    dataflow_iterations += flow.iterations;
+
+    for (int i = 0; i < basic_blocks.size(); i++) {
+        live = flow.outs[i];
+        walk(basic_blocks[i], live, [&](Instruction& inst) {
+            chains.erase_instruction(inst.label - label_0);
+            inst.to_nop();
+            statement_eliminated_cnt++;
+        });
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,276 @@
+#include <algorithm>
+
+#include "ir.h"
+namespace {
+// A map whose changes can be undone back to a mark, for the tables of a
+// walk down the dominator tree: what a block adds is dropped on the way back
+template <typename K, typename V, typename Hash = std::hash<K>>
+class ScopedMap {
+   private:
+    unordered_map<K, V, Hash> map;
+    vector<std::pair<K, std::optional<V>>> undo;
+
+   public:
+    const V* find(const K& key) const {
+        auto iter = map.find(key);
+        return iter == map.end() ? nullptr : &iter->second;
+    }
+    void set(const K& key, const V& value) {
+        auto iter = map.find(key);
+        if (iter == map.end()) {
+            undo.emplace_back(key, std::nullopt);
+            map.emplace(key, value);
+        } else {
+            undo.emplace_back(key, iter->second);
+            iter->second = value;
+        }
+    }
+    void erase(const K& key) {
+        auto iter = map.find(key);
+        if (iter == map.end())
+            return;
+        undo.emplace_back(key, iter->second);
+        map.erase(iter);
+    }
+    size_t mark() const { return undo.size(); }
+    void rollback(size_t mark) {
+        while (undo.size() > mark) {
+            auto& [key, value] = undo.back();
+            if (value)
+                map[key] = *value;
+            else
+                map.erase(key);
+            undo.pop_back();
+        }
+    }
+};
+
+// An operation on value numbers; loads also carry the memory version they read
+struct Expression {
+    Opcode::Type opcode;
+    uint32_t a, b, memory;
+    bool operator==(const Expression& e) const {
+        return opcode == e.opcode && a == e.a && b == e.b && memory == e.memory;
+    }
+};
+struct ExpressionHash {
+    size_t operator()(const Expression& e) const {
+        size_t h = e.opcode;
+        for (auto v : {e.a, e.b, e.memory})
+            h = h * 1000003 ^ v;
+        return h;
+    }
+};
+// An operand that names the same value wherever it appears: a constant, an address or an offset
+struct Leaf {
+    Operand::Type type;
+    uint32_t symbol;
+    long long payload;
+    bool operator==(const Leaf& l) const { return type == l.type && symbol == l.symbol && payload == l.payload; }
+};
+struct LeafHash {
+    size_t operator()(const Leaf& l) const { return (size_t(l.payload) * 1000003 ^ l.symbol) * 31 + l.type; }
+};
+// The register computing a value first, which later computations of it reuse
+struct Leader {
+    uint32_t value;
+    long long label;
+    uint32_t symbol;
+};
+// The value a variable holds, and the memory version when it was known
+struct Known {
+    uint32_t value, memory;
+};
+
+bool is_numbered(Opcode::Type opcode) {
+    switch (opcode) {
+        case Opcode::Type::ADD:
+        case Opcode::Type::SUB:
+        case Opcode::Type::MUL:
+        case Opcode::Type::DIV:
+        case Opcode::Type::MOD:
+        case Opcode::Type::NEG:
+        case Opcode::Type::CMPEQ:
+        case Opcode::Type::CMPLE:
+        case Opcode::Type::CMPLT:
+        case Opcode::Type::LOAD:
+            return true;
+        default:
+            return false;
+    }
+}
+bool is_commutative(Opcode::Type opcode) {
+    return opcode == Opcode::Type::ADD || opcode == Opcode::Type::MUL || opcode == Opcode::Type::CMPEQ;
+}
+}  // namespace
+
+// Dominator-scoped value numbering: the blocks are walked down the
+// dominator tree, and a computation whose value some dominating register
+// already holds becomes an assign of that register. Registers have one
+// definition, so their values are numbered once. Variables and memory are
+// versioned instead: a move gives the variable the value it copies, a
+// store or a call starts a new memory version, which also forgets the
+// globals and the locals whose address is taken. A block starts from the
+// tables of its immediate dominator, less what the blocks between the two
+// may write. Later reads of a replaced register read the earlier one, so
+// dse can remove the assign.
+void Function::gvn() {
+    const auto& dom = dominators();
+    const int bb_cnt = basic_blocks.size();
+
+    // what each block writes, and the variables a store or a call may write
+    unordered_set<uint32_t> exposed;
+    vector<vector<uint32_t>> moved(bb_cnt);
+    vector<char> writes_memory(bb_cnt, false);
+    for (int b = 0; b < bb_cnt; b++) {
+        for (const auto& inst : basic_blocks[b].instructions) {
+            if (inst.opcode.type == Opcode::Type::MOVE)
+                moved[b].push_back(inst.operands[1].symbol);
+            else if (inst.opcode.type == Opcode::Type::STORE || inst.opcode.type == Opcode::Type::CALL)
+                writes_memory[b] = true;
+            for (const auto& operand : inst.operands) {
+                if (operand.type == Operand::Type::LOCAL_ADDR || operand.type == Operand::Type::GLOBAL_ADDR ||
+                    operand.type == Operand::Type::GLOBAL_VARIABLE)
+                    exposed.insert(operand.symbol);
+            }
+        }
+    }
+
+    uint32_t value_cnt = 0;
+    unordered_map<Leaf, uint32_t, LeafHash> leaf_value;
+    unordered_map<long long, uint32_t> reg_value;     // by register label
+    unordered_map<long long, Operand> replaced_by;    // a replaced register -> the register it reads
+    ScopedMap<Expression, Leader, ExpressionHash> available;
+    ScopedMap<uint32_t, Known> variable_value;  // by variable symbol
+    uint32_t memory = value_cnt++;
+
+    auto value_of = [&](const Operand& operand) -> uint32_t {
+        switch (operand.type) {
+            case Operand::Type::REG: {
+                auto iter = reg_value.find(operand.reg_name);
+                if (iter == reg_value.end())
+                    iter = reg_value.emplace(operand.reg_name, value_cnt++).first;
+                return iter->second;
+            }
+            case Operand::Type::LOCAL_VARIABLE:
+            case Operand::Type::PARAMETER:
+            case Operand::Type::GLOBAL_VARIABLE: {
+                auto known = variable_value.find(operand.symbol);
+                if (known && (known->memory == memory || exposed.count(operand.symbol) == 0))
+                    return known->value;
+                Known fresh{value_cnt++, memory};
+                variable_value.set(operand.symbol, fresh);
+                return fresh.value;
+            }
+            default: {
+                auto iter = leaf_value.emplace(Leaf{operand.type, operand.symbol, operand.constant}, value_cnt).first;
+                if (iter->second == value_cnt)
+                    value_cnt++;
+                return iter->second;
+            }
+        }
+    };
+    // Forget what the blocks between b and its immediate dominator may write:
+    // those reaching b backwards without passing through the dominator
+    vector<int> seen(bb_cnt, -1), stack;
+    auto enter_block = [&](int b) {
+        if (b == dom.root)
+            return;
+        const int idom = dom.idom[b];
+        bool memory_written = false;
+        seen[idom] = b;
+        for (int p : dom.preds[b]) {
+            if (dom.reachable(p) && seen[p] != b) {
+                seen[p] = b;
+                stack.push_back(p);
+            }
+        }
+        while (!stack.empty()) {
+            int x = stack.back();
+            stack.pop_back();
+            for (auto symbol : moved[x])
+                variable_value.erase(symbol);
+            memory_written |= writes_memory[x];
+            for (int p : dom.preds[x]) {
+                if (dom.reachable(p) && seen[p] != b) {
+                    seen[p] = b;
+                    stack.push_back(p);
+                }
+            }
+        }
+        if (memory_written)
+            memory = value_cnt++;
+    };
+    auto number_block = [&](int b) {
+        for (auto& inst : basic_blocks[b].instructions) {
+            for (auto& operand : inst.operands) {
+                if (operand.type != Operand::Type::REG)
+                    continue;
+                auto iter = replaced_by.find(operand.reg_name);
+                if (iter != replaced_by.end())
+                    operand = iter->second;
+            }
+            const auto opcode = inst.opcode.type;
+            if (opcode == Opcode::Type::ASSIGN) {
+                reg_value[inst.label] = value_of(inst.operands[0]);
+            } else if (opcode == Opcode::Type::MOVE) {
+                variable_value.set(inst.operands[1].symbol, Known{value_of(inst.operands[0]), memory});
+            } else if (opcode == Opcode::Type::STORE || opcode == Opcode::Type::CALL) {
+                memory = value_cnt++;
+            } else if (is_numbered(opcode)) {
+                Expression e{opcode, value_of(inst.operands[0]), 0, 0};
+                if (inst.operands.size() > 1)
+                    e.b = value_of(inst.operands[1]);
+                if (is_commutative(opcode) && e.a > e.b)
+                    std::swap(e.a, e.b);
+                if (opcode == Opcode::Type::LOAD)
+                    e.memory = memory;
+                if (auto leader = available.find(e)) {
+                    Operand reg;
+                    reg.type = Operand::Type::REG;
+                    reg.symbol = leader->symbol;
+                    reg.reg_name = leader->label;
+                    inst.opcode.type = Opcode::Type::ASSIGN;
+                    inst.operands.clear();
+                    inst.operands.push_back(reg);
+                    reg_value[inst.label] = leader->value;
+                    replaced_by[inst.label] = reg;
+                    expressions_eliminated_cnt++;
+                } else {
+                    auto value = value_cnt++;
+                    available.set(e, Leader{value, inst.label, inst.symbol});
+                    reg_value[inst.label] = value;
+                }
+            } else if (inst.opcode.info().def == Opcode::DEF_REG) {
+                reg_value[inst.label] = value_cnt++;
+            }
+        }
+    };
+
+    // preorder down the dominator tree; each frame restores the tables of its parent when done
+    struct Frame {
+        int block;
+        size_t child, available_mark, variable_mark;
+        uint32_t memory;
+    };
+    vector<Frame> frames;
+    auto push = [&](int b) {
+        frames.push_back({b, 0, available.mark(), variable_value.mark(), memory});
+        enter_block(b);
+        number_block(b);
+    };
+    push(dom.root);
+    while (!frames.empty()) {
+        auto& frame = frames.back();
+        const auto& children = dom.children[frame.block];
+        if (frame.child < children.size()) {
+            push(children[frame.child++]);
+            continue;
+        }
+        available.rollback(frame.available_mark);
+        variable_value.rollback(frame.variable_mark);
+        memory = frame.memory;
+        frames.pop_back();
+    }
+    invalidate_chains();
+}
@@ -0,0 +1,258 @@
+#include <algorithm>
+
+#include "call-graph.h"
+#include "ir.h"
+namespace {
+// A callee of at most this many instructions, enter and ret aside, is
+// inlined at any call; a larger one only at its last call, after which it
+// is dropped, so that the program does not grow
+constexpr long long small_callee = 24;
+// Inlining grows a function by at most its own size, or by this many
+// instructions when it is smaller
+constexpr long long growth_floor = 64;
+
+long long size_of(const Function& func) {
+    long long cnt = 0;
+    for (const auto& bb : func.basic_blocks)
+        cnt += bb.size();
+    return cnt;
+}
+vector<Instruction> flatten(const Function& func) {
+    vector<Instruction> insts;
+    for (const auto& bb : func.basic_blocks)
+        insts.insert(insts.end(), bb.instructions.begin(), bb.instructions.end());
+    return insts;
+}
+}  // namespace
+
+// Each call in callee_at, by its label, is replaced with a copy of the
+// callee's instructions between its enter and its ret. Its params become
+// moves to new locals standing for the callee's parameters (a param the
+// callee never reads becomes a nop), the callee's locals are renamed and
+// moved right below the caller's, with the new parameters below them, and a
+// ret other than the last becomes a branch to the instruction after the
+// call. The copies take their labels from next_label on, and the function
+// is relabelled from its first.
+void Function::inline_calls(const unordered_map<long long, const Function*>& callee_at, SymbolTable& symbols,
+                            long long& next_label) {
+    // the names the new variables must not take
+    unordered_set<string> names;
+    auto add_names = [&](const Function& func) {
+        for (const auto& v : func.local_variables)
+            names.insert(v.variable_name);
+        for (const auto& v : func.params)
+            names.insert(v.variable_name);
+        for (const auto& bb : func.basic_blocks) {
+            for (const auto& inst : bb.instructions) {
+                for (const auto& operand : inst.operands) {
+                    if (operand.is_global())
+                        names.insert(symbols.name(operand.symbol));
+                }
+            }
+        }
+    };
+    add_names(*this);
+    for (const auto& [label, callee] : callee_at)
+        add_names(*callee);
+    // a variable is as large as the gap to the next one up, so the new ones go right below the lowest
+    long long lowest = 0;
+    for (const auto& v : local_variables)
+        lowest = std::min(lowest, v.address);
+    auto new_variable = [&](const string& name, Operand::Type type, long long offset) {
+        string fresh;
+        int cnt = 0;
+        do
+            fresh = name + "_" + std::to_string(cnt++);
+        while (names.count(fresh) > 0);
+        names.insert(fresh);
+        local_var_size = std::max(local_var_size, -offset);
+        Operand operand;
+        operand.type = type;
+        operand.offset = offset;
+        operand.symbol = symbols.intern(fresh, offset, SymbolTable::STORAGE);
+        return operand;
+    };
+
+    const auto old_insts = flatten(*this);
+    vector<Instruction> insts;
+    insts.reserve(old_insts.size());
+    // where the branches to an inlined call go now: its first copied instruction
+    unordered_map<long long, long long> entry_of;
+    vector<size_t> params;  // the positions in insts of the params of the next call
+    for (size_t i = 0; i < old_insts.size(); i++) {
+        const auto& inst = old_insts[i];
+        if (inst.is_block_leader)
+            params.clear();
+        if (inst.opcode.type == Opcode::Type::PARAM) {
+            params.push_back(insts.size());
+            insts.push_back(inst);
+            continue;
+        }
+        auto iter = inst.opcode.type == Opcode::Type::CALL ? callee_at.find(inst.label) : callee_at.end();
+        if (iter == callee_at.end()) {
+            if (inst.opcode.type == Opcode::Type::CALL)
+                params.clear();
+            insts.push_back(inst);
+            continue;
+        }
+        const auto& callee = *iter->second;
+        const long long continuation = old_insts[i + 1].label;
+        const long long k = params.size();
+        assert(k * 8 == callee.param_size);
+
+        // the callee's frame, then its parameters
+        const long long base = lowest;
+        for (const auto& v : callee.local_variables)
+            lowest = std::min(lowest, base + v.address);
+        unordered_map<long long, Operand> param_at, local_at;
+        for (const auto& v : callee.params) {
+            lowest -= 8;
+            param_at[v.address] = new_variable(v.variable_name, Operand::Type::LOCAL_VARIABLE, lowest);
+        }
+        // the first pushed is the farthest from the frame pointer
+        for (long long p = 0; p < k; p++) {
+            auto& param = insts[params[p]];
+            auto target = param_at.find(16 + 8 * (k - 1 - p));
+            if (target == param_at.end()) {
+                param.to_nop();
+                continue;
+            }
+            Instruction move(param.label, Opcode::Type::MOVE, symbols);
+            move.operands.push_back(param.operands[0]);
+            move.operands.push_back(target->second);
+            param = move;
+        }
+        params.clear();
+
+        // copy the body with new labels, then make its operands follow them
+        const auto body = flatten(callee);
+        unordered_map<long long, long long> new_label;
+        unordered_map<long long, uint32_t> new_symbol;
+        new_label[body.back().label] = continuation;
+        const size_t first = insts.size();
+        for (size_t j = 1; j + 1 < body.size(); j++) {
+            const bool is_ret = body[j].opcode.type == Opcode::Type::RET;
+            Instruction copy(next_label++, is_ret ? Opcode::Type::BR : body[j].opcode.type, symbols);
+            if (is_ret) {
+                Operand operand;
+                operand.type = Operand::Type::LABEL;
+                operand.inst_label = body.back().label;
+                copy.operands.push_back(operand);
+            } else {
+                copy.operands = body[j].operands;
+            }
+            new_label[body[j].label] = copy.label;
+            new_symbol[body[j].label] = copy.symbol;
+            insts.push_back(copy);
+        }
+        for (size_t j = first; j < insts.size(); j++) {
+            for (auto& operand : insts[j].operands) {
+                if (operand.type == Operand::Type::REG) {
+                    operand.symbol = new_symbol.at(operand.reg_name);
+                    operand.reg_name = new_label.at(operand.reg_name);
+                } else if (operand.type == Operand::Type::LABEL) {
+                    operand.inst_label = new_label.at(operand.inst_label);
+                } else if (operand.type == Operand::Type::PARAMETER) {
+                    operand = param_at.at(operand.offset);
+                } else if (operand.is_local()) {
+                    auto [local, inserted] = local_at.try_emplace(operand.offset);
+                    if (inserted)
+                        local->second = new_variable(symbols.name(operand.symbol), operand.type, base + operand.offset);
+                    const auto type = operand.type;
+                    operand = local->second;
+                    operand.type = type;
+                }
+            }
+        }
+        entry_of[inst.label] = first < insts.size() ? insts[first].label : continuation;
+        calls_inlined_cnt++;
+    }
+    // a call right after an inlined one may be inlined as well, so this comes last
+    for (auto& inst : insts) {
+        for (auto& operand : inst.operands) {
+            if (operand.type != Operand::Type::LABEL)
+                continue;
+            for (auto iter = entry_of.find(operand.inst_label); iter != entry_of.end();
+                 iter = entry_of.find(operand.inst_label))
+                operand.inst_label = iter->second;
+        }
+    }
+    insts.front().operands[0].constant = local_var_size;
+    relabel(insts, symbols);
+}
+
+// Bottom-up over the call graph, so that a callee has had its own calls
+// inlined before it is copied anywhere. Calls into a recursive SCC, or within
+// one, are left alone.
+void Program::inline_calls() {
+    const int n = functions.size();
+    CallGraph graph(functions);
+    unordered_map<long long, int> index_of_id;
+    for (int f = 0; f < n; f++)
+        index_of_id[functions[f].id] = f;
+    auto callees = [&](int f) {
+        vector<int> out;
+        for (const auto& bb : functions[f].basic_blocks) {
+            for (const auto& inst : bb.instructions) {
+                if (inst.opcode.type != Opcode::Type::CALL)
+                    continue;
+                auto iter = index_of_id.find(inst.operands[0].function_id);
+                if (iter != index_of_id.end())
+                    out.push_back(iter->second);
+            }
+        }
+        return out;
+    };
+    // the calls left to each function, copies made by inlining included
+    vector<long long> calls(n, 0);
+    for (int f = 0; f < n; f++) {
+        for (int c : callees(f))
+            calls[c]++;
+    }
+    const vector<long long> calls_before = calls;
+
+    // the copies intern their registers and variables, so one function at a time
+    advance_next_label();
+    for (const auto& scc : graph.sccs) {
+        for (int f : scc) {
+            const long long budget = std::max(size_of(functions[f]), growth_floor);
+            long long growth = 0;
+            unordered_map<long long, const Function*> callee_at;
+            for (const auto& bb : functions[f].basic_blocks) {
+                long long pushed = 0;
+                for (const auto& inst : bb.instructions) {
+                    if (inst.opcode.type == Opcode::Type::PARAM)
+                        pushed++;
+                    if (inst.opcode.type != Opcode::Type::CALL)
+                        continue;
+                    auto iter = index_of_id.find(inst.operands[0].function_id);
+                    const int c = iter == index_of_id.end() ? -1 : iter->second;
+                    const long long size = c < 0 ? 0 : size_of(functions[c]) - 2;
+                    if (c >= 0 && graph.scc_of[c] != graph.scc_of[f] && !graph.is_recursive[graph.scc_of[c]] &&
+                        pushed * 8 == functions[c].param_size && (size <= small_callee || calls[c] == 1) &&
+                        growth + size <= budget) {
+                        callee_at[inst.label] = &functions[c];
+                        growth += size;
+                        calls[c]--;
+                        for (int d : callees(c))
+                            calls[d]++;
+                    }
+                    pushed = 0;
+                }
+            }
+            if (!callee_at.empty())
+                functions[f].inline_calls(callee_at, symbols, next_label);
+        }
+    }
+
+    // drop the functions whose calls were all inlined, keeping the first label of the program
+    const long long first = functions.empty() ? 0 : functions.front().id;
+    vector<Function> kept;
+    kept.reserve(n);
+    for (int f = 0; f < n; f++) {
+        if (calls_before[f] == 0 || calls[f] > 0 || functions[f].is_main)
+            kept.push_back(std::move(functions[f]));
+    }
+    functions = std::move(kept);
+    renumber(first);
+}
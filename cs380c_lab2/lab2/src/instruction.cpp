@@ -1,134 +1,98 @@
+#include <climits>
+
 #include "ir.h"
-Instruction::Instruction(const string& s) : is_block_leader(false), predecessor_labels({}) {
+Instruction::Instruction(string_view s, SymbolTable& symbols) : symbol(SymbolTable::NONE), is_block_leader(false), is_branch_target(false) {
     //instr 33:   add   global_array_base#32576   GP
-    //      1 2   3  4  6                      8  75
-    auto idx1 = s.find_first_of("0123456789");
-    auto idx2 = s.find_first_of(':');
-    auto idx3 = s.find_first_not_of(' ', idx2 + 1);
-    assert(idx3 != string::npos && idx3 < s.size());
-    assert(idx1 != string::npos && idx2 != string::npos && idx1 != idx2);
-    this->label = atoll(s.substr(idx1, idx2 - idx1).c_str());
-    this->opcode = Opcode(s);
-    if (Opcode::operand_cnt.at(opcode.type) > 0) {
-        auto idx4 = s.find_first_of(' ', idx3);
-        assert(idx4 != string::npos && idx4 < s.size());
-        auto idx6 = s.find_first_not_of(' ', idx4);
-        auto is_function = (s.find("call") != string::npos);
-        if (Opcode::operand_cnt.at(opcode.type) == 1) {
-            operands.emplace_back(s.substr(idx6), is_function);
-        } else {
-            auto idx8 = s.find_first_of(' ', idx6);
-            operands.emplace_back(s.substr(idx6, idx8 - idx6));
-            auto idx7 = s.find_first_not_of(' ', idx8);
-            auto idx5 = s.find_last_not_of(' ');
-            operands.emplace_back(s.substr(idx7, idx5 - idx7 + 1));
-        }
+    //      1  2  3     4                         4
+    // 1 label, 2 ':', 3 mnemonic, 4 operands; every token is a view into s
+    size_t i = 0;
+    const size_t n = s.size();
+    auto skip_spaces = [&]() {
+        while (i < n && (s[i] == ' ' || s[i] == '\t' || s[i] == '\r'))
+            ++i;
+    };
+    auto next_token = [&]() {
+        skip_spaces();
+        auto begin = i;
+        while (i < n && s[i] != ' ' && s[i] != '\t' && s[i] != '\r')
+            ++i;
+        return s.substr(begin, i - begin);
+    };
+    while (i < n && (s[i] < '0' || s[i] > '9'))
+        ++i;
+    auto label_begin = i;
+    while (i < n && s[i] >= '0' && s[i] <= '9')
+        ++i;
+    assert(i > label_begin && i < n && s[i] == ':');
+    this->label = to_ll(s.substr(label_begin, i - label_begin));
+    ++i;
+    this->opcode = Opcode(next_token());
+    assert(opcode.type != Opcode::Type::INVALID);
+    auto cnt = opcode.operand_cnt();
+    auto is_function = (opcode.type == Opcode::Type::CALL);
+    for (int k = 0; k < cnt; k++) {
+        auto token = next_token();
+        assert(token.size() > 0);
+        operands.emplace_back(token, symbols, is_function);
     }
-    assert(operands.size() == Opcode::operand_cnt.at(opcode.type));
+    assert(operands.size() == cnt);
+    if (opcode.info().def == Opcode::Def::DEF_REG)
+        this->symbol = symbols.intern_reg(this->label);
+}
+
+Instruction::Instruction(long long _label, Opcode _opcode, SymbolTable& symbols)
+    : label(_label), symbol(SymbolTable::NONE), opcode(_opcode), is_block_leader(false), is_branch_target(false) {
+    assert(opcode.type != Opcode::Type::INVALID);
+    if (opcode.info().def == Opcode::Def::DEF_REG)
+        this->symbol = symbols.intern_reg(this->label);
 }
 
-deque<string> Instruction::context = {};
+string Instruction::ccode(const SymbolTable& symbols, const RegisterSlots& regs, vector<string>& args) const {
+    auto code = cstatement(symbols, regs, args);
+    if (!this->is_branch_target || opcode.type == Opcode::Type::ENTER || opcode.type == Opcode::Type::ENTRYPC)
+        return code;
+    return "inst_" + std::to_string(this->label) + ":" + code;
+}
 
-string Instruction::ccode() const {
+string Instruction::cstatement(const SymbolTable& symbols, const RegisterSlots& regs, vector<string>& args) const {
     std::stringstream tmp;
-    if (this->predecessor_labels.size() > 0)
-        tmp << "inst_" << this->label << ":";
     switch (this->opcode.type) {
-        case Opcode::Type::ADD:
-            tmp << "REG[" << this->label << "] = " << operands[0].ccode() << " + " << operands[1].ccode() << ";";
-            return tmp.str();
-        case Opcode::Type::SUB:
-            tmp << "REG[" << this->label << "] = " << operands[0].ccode() << " - " << operands[1].ccode() << ";";
-            return tmp.str();
-        case Opcode::Type::MUL:
-            tmp << "REG[" << this->label << "] = " << operands[0].ccode() << " * " << operands[1].ccode() << ";";
-            return tmp.str();
-        case Opcode::Type::DIV:
-            tmp << "REG[" << this->label << "] = " << operands[0].ccode() << " / " << operands[1].ccode() << ";";
-            return tmp.str();
-        case Opcode::Type::MOD:
-            tmp << "REG[" << this->label << "] = " << operands[0].ccode() << " % " << operands[1].ccode() << ";";
-            return tmp.str();
-        case Opcode::Type::NEG:
-            tmp << "REG[" << this->label << "] = -" << operands[0].ccode() << " ; ";
-            return tmp.str();
-        case Opcode::Type::CMPEQ:
-            tmp << "REG[" << this->label << "] = " << operands[0].ccode() << " == " << operands[1].ccode() << ";";
-            return tmp.str();
-        case Opcode::Type::CMPLE:
-            tmp << "REG[" << this->label << "] = " << operands[0].ccode() << " <= " << operands[1].ccode() << ";";
-            return tmp.str();
-        case Opcode::Type::CMPLT:
-            tmp << "REG[" << this->label << "] = " << operands[0].ccode() << " < " << operands[1].ccode() << ";";
-            return tmp.str();
-        case Opcode::Type::BR:
-            tmp << "goto " << operands[0].ccode() << ";";
-            return tmp.str();
-        case Opcode::Type::BLBC:
-            tmp << "if(" << operands[0].ccode() << " == 0) goto " << operands[1].ccode() << ";";
-            return tmp.str();
-        case Opcode::Type::BLBS:
-            tmp << "if(" << operands[0].ccode() << " !=0) goto " << operands[1].ccode() << ";";
-            return tmp.str();
-        case Opcode::Type::LOAD:
-            tmp << "REG[" << this->label << "] = "
-                << "*((long *)" << operands[0].ccode() << ");";
-            return tmp.str();
-        case Opcode::Type::STORE:
-            tmp << "*( (long *)" << operands[1].ccode() << ") = " << operands[0].ccode() << ";";
-            return tmp.str();
-        case Opcode::Type::MOVE:
-            tmp << operands[1].ccode() << " = " << operands[0].ccode() << ";";
-            return tmp.str();
-        case Opcode::Type::READ:
-            tmp << "ReadLong(" << operands[0].ccode() << ");";
-            return tmp.str();
-        case Opcode::Type::WRITE:
-            tmp << "WriteLong(" << operands[0].ccode() << ");";
-            return tmp.str();
-        case Opcode::Type::WRL:
-            tmp << "WriteLine();";
-            return tmp.str();
         case Opcode::Type::PARAM:
-            Instruction::context.push_back(operands[0].ccode());
+            args.push_back(operands[0].ccode(symbols, regs));
             return tmp.str();
         case Opcode::Type::ENTER:
-            return "";
         case Opcode::Type::ENTRYPC:
             return "";
         case Opcode::Type::CALL:
-            tmp << operands[0].ccode();
+            tmp << operands[0].ccode(symbols, regs);
             tmp << "(";
-            while (!Instruction::context.empty()) {
-                tmp << Instruction::context.front();
-                Instruction::context.pop_front();
-                if (!Instruction::context.empty())
+            for (size_t i = 0; i < args.size(); i++) {
+                if (i > 0)
                     tmp << ",";
+                tmp << args[i];
             }
+            args.clear();
             tmp << ");";
             return tmp.str();
-        case Opcode::Type::RET:
-            tmp << "return ;";
-            return tmp.str();
-        case Opcode::Type::NOP:
-            return tmp.str();  // Can't return empty string directly, because jump labels may need to be output
-        case Opcode::Type::ASSIGN:
-            tmp << "REG[" << this->label << "] = " << operands[0].ccode() << ";";
-            return tmp.str();
+        default:
+            break;
+    }
+    for (auto c = opcode.info().c_template; *c; ++c) {
+        if (c[0] != '%' || c[1] == ' ') {
+            tmp << *c;
+            continue;
+        }
+        ++c;
+        if (*c == 'd')
+            tmp << regs.name(this->label);
+        else
+            tmp << operands[*c - '0'].ccode(symbols, regs);
     }
     return tmp.str();
 }
 
 bool Instruction::is_branch() const {
-    switch (this->opcode.type) {
-        case Opcode::Type::BR:
-        case Opcode::Type::BLBC:
-        case Opcode::Type::BLBS:
-            return true;
-        default:
-            return false;
-    }
-    return false;
+    return opcode.info().is_branch;
 }
 
 long long Instruction::branch_target_label() const {
@@ -136,11 +100,11 @@ long long Instruction::branch_target_label() const {
     return operands.back().inst_label;
 }
 
-string Instruction::icode() const {
+string Instruction::icode(const SymbolTable& symbols) const {
     std::stringstream tmp;
-    tmp << "    instr " << this->label << ": " << Opcode::opcode_name[this->opcode.type];
+    tmp << "    instr " << this->label << ": " << this->opcode.name();
     for (auto& op : operands) {
-        tmp << " " << op.icode();
+        tmp << " " << op.icode(symbols);
     }
     tmp << std::endl;
     return tmp.str();
@@ -149,48 +113,19 @@ void Instruction::to_nop() {
     this->opcode.type = Opcode::Type::NOP;
     this->operands.clear();
 }
-string Instruction::get_def() const {
-    switch (this->opcode.type) {
-        case Opcode::Type::MOVE:
-            return operands.back().icode();
-
-        case Opcode::Type::BLBC:
-        case Opcode::Type::BLBS:
-        case Opcode::Type::BR:
-        case Opcode::Type::CALL:
-        case Opcode::Type::END:
-        case Opcode::Type::ENTER:
-        case Opcode::Type::ENTRYPC:
-        case Opcode::Type::INVALID:
-        case Opcode::Type::NOP:
-        case Opcode::Type::PARAM:
-        case Opcode::Type::RET:
-        case Opcode::Type::STORE:
-        case Opcode::Type::WRITE:
-        case Opcode::Type::WRL:
-            return "";
-
-        case Opcode::Type::ADD:
-        case Opcode::Type::ASSIGN:
-        case Opcode::Type::CMPEQ:
-        case Opcode::Type::CMPLE:
-        case Opcode::Type::CMPLT:
-        case Opcode::Type::DIV:
-        case Opcode::Type::LOAD:
-        case Opcode::Type::MOD:
-        case Opcode::Type::MUL:
-        case Opcode::Type::NEG:
-        case Opcode::Type::READ:
-        case Opcode::Type::SUB:
-            std::stringstream tmp;
-            tmp << "(" << this->label << ")";
-            return tmp.str();
+uint32_t Instruction::get_def() const {
+    switch (opcode.info().def) {
+        case Opcode::Def::DEF_LAST:
+            return operands.back().symbol;
+        case Opcode::Def::DEF_REG:
+            return this->symbol;
+        default:
+            return SymbolTable::NONE;
     }
-    return "";
 }
 
 bool Instruction::is_def() const {
-    return this->get_def().size() > 0;
+    return this->get_def() != SymbolTable::NONE;
 }
 
 bool Instruction::is_constant_def() const {
@@ -207,12 +142,12 @@ long long Instruction::const_def_val() const {
     assert(is_constant_def());
     return operands.front().constant;
 }
-void Instruction::peephole2() {
+bool Instruction::peephole2() {
     if (operands.size() != 2)
-        return;
+        return false;
     for (auto& operand : operands) {
         if (operand.type != Operand::Type::CONSTANT)
-            return;
+            return false;
     }
     long long n_val = 0;
     switch (opcode.type) {
@@ -226,6 +161,9 @@ void Instruction::peephole2() {
             n_val = operands[0].constant * operands[1].constant;
             break;
         case Opcode::Type::DIV:
+            // left for run time, which only traps if the path is taken
+            if (operands[1].constant == 0 || (operands[0].constant == LLONG_MIN && operands[1].constant == -1))
+                return false;
             n_val = operands[0].constant / operands[1].constant;
             break;
         case Opcode::Type::CMPLT:
@@ -239,88 +177,57 @@ void Instruction::peephole2() {
             break;
 
         default:
-            return;
+            return false;
     }
     opcode.type = Opcode::Type::ASSIGN;
     operands[0].constant = n_val;
     operands[0].type = Operand::Type::CONSTANT;
     operands.resize(1);
-    ++peephole2_cnt;
+    return true;
 }
 bool Instruction::is_arithmetic() const {
-    switch (opcode.type) {
-        case Opcode::Type::ADD:
-        case Opcode::Type::SUB:
-        case Opcode::Type::MUL:
-        case Opcode::Type::DIV:
-        case Opcode::Type::CMPEQ:
-        case Opcode::Type::CMPLE:
-        case Opcode::Type::CMPLT:
-        case Opcode::Type::ASSIGN:
-            return true;
-        default:
-            return false;
-    }
-    return false;
+    return opcode.info().is_arithmetic;
 }
-void Instruction::peephole3() {
+bool Instruction::peephole3() {
     if (opcode.type != Opcode::Type::ADD)
-        return;
+        return false;
     if (operands[1].type != Operand::Type::CONSTANT)
-        return;
+        return false;
     if (operands[1].constant != 0)
-        return;
+        return false;
     if (operands[0].type != Operand::Type::REG)
-        return;
+        return false;
     opcode.type = Opcode::Type::ASSIGN;
     operands.resize(1);
-    ++peephole3_cnt;
+    return true;
 }
-int Instruction::peephole2_cnt = 0;
-int Instruction::peephole3_cnt = 0;
 
-vector<string> Instruction::get_use_dse() const {
-    vector<string> res = {};
-    switch (opcode.type) {
-        case Opcode::Type::ADD:
-        case Opcode::Type::SUB:
-        case Opcode::Type::MUL:
-        case Opcode::Type::DIV:
-        case Opcode::Type::MOD:
-        case Opcode::Type::NEG:
-        case Opcode::Type::CMPEQ:
-        case Opcode::Type::CMPLE:
-        case Opcode::Type::CMPLT:
-        case Opcode::Type::LOAD:
-        case Opcode::Type::STORE:
-        case Opcode::Type::ASSIGN:
-        case Opcode::Type::PARAM:
-        case Opcode::Type::WRITE:
-            for (const auto& op : operands) {
-                if (op.is_local() || op.is_reg()) {
-                    res.push_back(op.icode());
+array<uint32_t, 2> Instruction::get_use_dse() const {
+    array<uint32_t, 2> res = {SymbolTable::NONE, SymbolTable::NONE};
+    switch (opcode.info().use) {
+        case Opcode::Use::USE_ALL:
+            for (int i = 0; i < operands.size(); i++) {
+                if (operands[i].is_local() || operands[i].is_reg()) {
+                    res[i] = operands[i].symbol;
                 }
             }
             return res;
-        case Opcode::Type::BLBC:
-        case Opcode::Type::BLBS:
-        case Opcode::Type::MOVE:
+        case Opcode::Use::USE_FIRST:
             if (operands[0].is_local() || operands[0].is_reg()) {
-                res.push_back(operands[0].icode());
+                res[0] = operands[0].symbol;
             }
         default:
             return res;
     }
 }
 
-string Instruction::get_def_dse()const{
-    if(opcode.type==Opcode::Type::MOVE){
-        if(operands[1].is_local()||operands[1].is_reg()){
-            return operands[1].icode();
+uint32_t Instruction::get_def_dse() const {
+    if (opcode.type == Opcode::Type::MOVE) {
+        if (operands[1].is_local() || operands[1].is_reg()) {
+            return operands[1].symbol;
         }
-        return "";
-    }
-    else{
+        return SymbolTable::NONE;
+    } else {
         return get_def();
     }
-}
\ No newline at end of file
+}
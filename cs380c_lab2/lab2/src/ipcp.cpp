@@ -0,0 +1,194 @@
+#include <algorithm>
+
+#include "call-graph.h"
+#include "ir.h"
+namespace {
+// What the calls of a function pass for one parameter or global: nothing
+// seen yet (TOP), always the same constant, or anything (BOTTOM)
+struct Lattice {
+    enum State : unsigned char { TOP, CONSTANT, BOTTOM };
+    State state = TOP;
+    long long value = 0;
+    // Meet with the value of one call, nullopt if it is not constant; true if this changed
+    bool meet(std::optional<long long> v) {
+        if (state == BOTTOM)
+            return false;
+        if (v && state == TOP) {
+            state = CONSTANT;
+            value = *v;
+            return true;
+        }
+        if (v && value == *v)
+            return false;
+        state = BOTTOM;
+        return true;
+    }
+};
+// The entry values of a function's parameters and globals, by symbol
+using EntryValues = unordered_map<uint32_t, Lattice>;
+
+void sort_unique(vector<uint32_t>& symbols) {
+    std::sort(symbols.begin(), symbols.end());
+    symbols.erase(std::unique(symbols.begin(), symbols.end()), symbols.end());
+}
+}  // namespace
+
+void Program::ipcp() {
+    const int n = functions.size();
+    CallGraph graph(functions);
+    unordered_map<long long, int> index_of_id;
+    for (int f = 0; f < n; f++)
+        index_of_id[functions[f].id] = f;
+
+    // Local summaries: the globals each function writes and reads by name,
+    // those whose address it takes, and the symbol of its parameter at each
+    // frame offset
+    vector<vector<uint32_t>> mod(n), ref(n), address_taken(n);
+    vector<unordered_map<long long, uint32_t>> param_at(n);
+    for_each_function([&](size_t f) {
+        for (const auto& bb : functions[f].basic_blocks) {
+            for (const auto& inst : bb.instructions) {
+                for (size_t k = 0; k < inst.operands.size(); k++) {
+                    const auto& operand = inst.operands[k];
+                    if (operand.type == Operand::Type::GLOBAL_VARIABLE) {
+                        if (inst.opcode.type == Opcode::Type::MOVE && k == 1)
+                            mod[f].push_back(operand.symbol);
+                        else
+                            ref[f].push_back(operand.symbol);
+                    } else if (operand.type == Operand::Type::GLOBAL_ADDR) {
+                        address_taken[f].push_back(operand.symbol);
+                    } else if (operand.type == Operand::Type::PARAMETER) {
+                        param_at[f][operand.offset] = operand.symbol;
+                    }
+                }
+            }
+        }
+        sort_unique(mod[f]);
+        sort_unique(ref[f]);
+    });
+    // A global whose address is taken may be written through a pointer by
+    // any call, and is never assumed constant on entry
+    vector<uint32_t> escaped;
+    for (const auto& symbols : address_taken)
+        escaped.insert(escaped.end(), symbols.begin(), symbols.end());
+    sort_unique(escaped);
+    auto is_escaped = [&](uint32_t symbol) { return std::binary_search(escaped.begin(), escaped.end(), symbol); };
+
+    // Bottom-up: an SCC may write and read what its functions do and what
+    // the SCCs they call may. The SCCs of one height never call each other.
+    vector<char> calls_unknown(n, false);
+    for (const auto& group : graph.by_height) {
+        for_each_task(group.size(), [&](size_t g) {
+            const auto s = group[g];
+            vector<uint32_t> scc_mod, scc_ref;
+            bool unknown = false;
+            for (auto f : graph.sccs[s]) {
+                unknown |= graph.calls_unknown[f];
+                scc_mod.insert(scc_mod.end(), mod[f].begin(), mod[f].end());
+                scc_ref.insert(scc_ref.end(), ref[f].begin(), ref[f].end());
+                for (auto c : graph.callees[f]) {
+                    if (graph.scc_of[c] == s)
+                        continue;
+                    unknown |= calls_unknown[c];
+                    scc_mod.insert(scc_mod.end(), mod[c].begin(), mod[c].end());
+                    scc_ref.insert(scc_ref.end(), ref[c].begin(), ref[c].end());
+                }
+            }
+            sort_unique(scc_mod);
+            sort_unique(scc_ref);
+            for (auto f : graph.sccs[s]) {
+                mod[f] = scc_mod;
+                ref[f] = scc_ref;
+                calls_unknown[f] = unknown;
+            }
+        });
+    }
+    // what scp may assume a call writes; a callee that may reach an unknown function is left out, so it writes anything
+    unordered_map<long long, vector<uint32_t>> mod_of_callee;
+    for (int f = 0; f < n; f++) {
+        if (calls_unknown[f])
+            continue;
+        auto& symbols = mod_of_callee[functions[f].id];
+        std::set_union(mod[f].begin(), mod[f].end(), escaped.begin(), escaped.end(), std::back_inserter(symbols));
+    }
+
+    // Meet what a call passes into the entry values of its callee c; true if they changed
+    auto meet_call = [&](const CallSite& site, int c, EntryValues& values) {
+        bool changed = false;
+        // the last argument pushed sits at FP+16, the one before at FP+24 and so on
+        const auto arg_cnt = functions[c].param_size / 8;
+        for (auto [offset, symbol] : param_at[c]) {
+            std::optional<long long> value;
+            auto i = arg_cnt - 1 - (offset - 16) / 8;
+            if (site.args.size() == arg_cnt && i >= 0 && i < arg_cnt)
+                value = site.args[i];
+            changed |= values[symbol].meet(value);
+        }
+        for (auto symbol : ref[c]) {
+            std::optional<long long> value;
+            auto iter = site.globals.find(symbol);
+            if (iter != site.globals.end() && !is_escaped(symbol))
+                value = iter->second;
+            changed |= values[symbol].meet(value);
+        }
+        return changed;
+    };
+    auto context_of = [&](int f, const EntryValues& values) {
+        ScpContext context;
+        context.mod = &mod_of_callee;
+        // main is entered with nothing known, whoever else calls it
+        if (functions[f].is_main)
+            return context;
+        for (const auto& [symbol, value] : values) {
+            if (value.state == Lattice::CONSTANT)
+                context.entry_constants[symbol] = value.value;
+        }
+        return context;
+    };
+
+    // Top-down: every call into an SCC is known before it is optimized, as
+    // its callers have smaller depths. The entry values of a recursive SCC
+    // also depend on its own calls: assume only the calls from outside, run
+    // scp on copies of its functions, meet in the calls inside, and repeat
+    // until nothing changes; only then optimize the functions themselves.
+    vector<EntryValues> entry(n);
+    vector<vector<CallSite>> calls(n);
+    for (const auto& group : graph.by_depth) {
+        for_each_task(group.size(), [&](size_t g) {
+            const auto s = group[g];
+            const auto& members = graph.sccs[s];
+            for (bool changed = graph.is_recursive[s]; changed;) {
+                changed = false;
+                unordered_map<int, EntryValues> assumed;
+                for (auto f : members)
+                    assumed[f] = entry[f];
+                for (auto f : members) {
+                    Function copy = functions[f];
+                    auto context = context_of(f, assumed[f]);
+                    vector<CallSite> copy_calls;
+                    copy.scp_peephole(&context, &copy_calls);
+                    for (const auto& site : copy_calls) {
+                        auto iter = index_of_id.find(site.callee);
+                        if (iter != index_of_id.end() && graph.scc_of[iter->second] == s)
+                            changed |= meet_call(site, iter->second, entry[iter->second]);
+                    }
+                }
+            }
+            for (auto f : members) {
+                auto context = context_of(f, entry[f]);
+                functions[f].scp_peephole(&context, &calls[f]);
+            }
+        });
+        // the calls into the deeper SCCs, serially and in order so the result does not depend on the schedule
+        for (auto s : group) {
+            for (auto f : graph.sccs[s]) {
+                for (const auto& site : calls[f]) {
+                    auto iter = index_of_id.find(site.callee);
+                    if (iter != index_of_id.end() && graph.scc_of[iter->second] != s)
+                        meet_call(site, iter->second, entry[iter->second]);
+                }
+                calls[f].clear();
+            }
+        }
+    }
+}
@@ -0,0 +1,527 @@
+#include <algorithm>
+
+#include "ir.h"
+namespace {
+Operand constant_operand(long long value) {
+    Operand operand;
+    operand.type = Operand::Type::CONSTANT;
+    operand.constant = value;
+    return operand;
+}
+Operand reg_operand(const Instruction& def) {
+    Operand operand;
+    operand.type = Operand::Type::REG;
+    operand.symbol = def.symbol;
+    operand.reg_name = def.label;
+    return operand;
+}
+bool is_scalar(const Operand& operand) {
+    return operand.type == Operand::Type::LOCAL_VARIABLE || operand.type == Operand::Type::PARAMETER;
+}
+
+// Loop-invariant values as terms over operands, hash-consed so that equal
+// terms share an index, with the arithmetic on constants folded
+class Terms {
+   private:
+    struct Term {
+        Opcode::Type opcode;  // INVALID for a leaf
+        Operand leaf;
+        int a, b;
+    };
+    vector<Term> terms;
+    map<std::tuple<int, uint32_t, long long>, int> leaves;
+    map<std::tuple<int, int, int>, int> nodes;
+
+   public:
+    int leaf(const Operand& operand) {
+        const bool has_payload = operand.type != Operand::Type::GP && operand.type != Operand::Type::FP;
+        auto key = std::make_tuple(int(operand.type), operand.symbol, has_payload ? operand.constant : 0);
+        auto [iter, inserted] = leaves.emplace(key, terms.size());
+        if (inserted)
+            terms.push_back({Opcode::Type::INVALID, operand, -1, -1});
+        return iter->second;
+    }
+    int constant(long long value) { return leaf(constant_operand(value)); }
+    bool is_constant(int t) const {
+        return terms[t].opcode == Opcode::Type::INVALID && terms[t].leaf.type == Operand::Type::CONSTANT;
+    }
+    long long value(int t) const { return terms[t].leaf.constant; }
+    // a op b, for add, sub or mul
+    int node(Opcode::Type opcode, int a, int b) {
+        if (is_constant(a) && is_constant(b)) {
+            if (opcode == Opcode::Type::ADD)
+                return constant(value(a) + value(b));
+            if (opcode == Opcode::Type::SUB)
+                return constant(value(a) - value(b));
+            return constant(value(a) * value(b));
+        }
+        if (opcode != Opcode::Type::SUB && is_constant(a))
+            std::swap(a, b);
+        if (is_constant(b) && value(b) == (opcode == Opcode::Type::MUL ? 1 : 0))
+            return a;
+        if (opcode == Opcode::Type::MUL && is_constant(b) && value(b) == 0)
+            return b;
+        if (opcode != Opcode::Type::SUB && a > b)
+            std::swap(a, b);
+        auto [iter, inserted] = nodes.emplace(std::make_tuple(int(opcode), a, b), terms.size());
+        if (inserted)
+            terms.push_back({opcode, Operand(), a, b});
+        return iter->second;
+    }
+    const Term& operator[](int t) const { return terms[t]; }
+    size_t size() const { return terms.size(); }
+};
+
+// A basic induction variable: a scalar moved to once in the loop, from
+// itself plus a constant step
+struct BasicIV {
+    Operand variable;
+    long long step;
+    long long move;  // the label of the move
+};
+// The value base + v * factor of a basic induction variable v, with
+// invariant terms factor and base; multiplied when computing it takes a mul
+struct Form {
+    uint32_t basic;
+    int factor, base;
+    bool multiplied;
+};
+}  // namespace
+
+// Strength reduction of the induction variables of every natural loop, one
+// nesting level per round from the innermost out. A register of the loop
+// holding base + v * factor, for a basic induction variable v and invariant
+// base and factor, through a mul somewhere on the way, gets a variable of
+// its own: set in a new preheader, and bumped by step * factor right after
+// the move to v, so that the two never disagree. Where the register is read
+// outside such chains, it becomes an assign of the variable, and the reads
+// after it in its block read the variable instead; the muls and adds that
+// computed it are left to dse. A compare of v with an invariant bound then
+// compares a variable of a positive constant factor with the bound mapped
+// the same way, so that v itself may die as well. The variables of v are
+// made only when that saves more instructions than their bumps cost.
+// Invariant operands that the loop computes are computed again in the
+// preheader, which licm, run before, mostly spares.
+void Function::reduce_strength(SymbolTable& symbols, long long& next_label) {
+    // the names the new variables must not take
+    unordered_set<string> names;
+    for (const auto& v : local_variables)
+        names.insert(v.variable_name);
+    for (const auto& v : params)
+        names.insert(v.variable_name);
+    for (const auto& bb : basic_blocks) {
+        for (const auto& inst : bb.instructions) {
+            for (const auto& operand : inst.operands) {
+                if (operand.is_global())
+                    names.insert(symbols.name(operand.symbol));
+            }
+        }
+    }
+    // a variable is as large as the gap to the next one up, so the new ones go right below the lowest
+    long long lowest = 0;
+    for (const auto& v : local_variables)
+        lowest = std::min(lowest, v.address);
+    int name_cnt = 0;
+    auto new_variable = [&]() {
+        string name;
+        do
+            name = "iv" + std::to_string(name_cnt++);
+        while (names.count(name) > 0);
+        names.insert(name);
+        lowest -= 8;
+        local_var_size = std::max(local_var_size, -lowest);
+        Operand operand;
+        operand.type = Operand::Type::LOCAL_VARIABLE;
+        operand.offset = lowest;
+        operand.symbol = symbols.intern(name, operand.offset, SymbolTable::STORAGE);
+        return operand;
+    };
+    auto new_instruction = [&](Opcode::Type opcode, const Operand& a, const Operand& b) {
+        Instruction inst(next_label++, opcode, symbols);
+        inst.operands.push_back(a);
+        inst.operands.push_back(b);
+        return inst;
+    };
+
+    for (int round = 0;; round++) {
+        const auto& forest = loops();
+        auto& chains = this->chains();
+        const auto label_0 = chains.label_0;
+        auto block_of = [&](long long label) { return int(chains.block_of_inst[label - label_0]); };
+        auto inst_at = [&](long long label) -> Instruction& {
+            auto& bb = basic_blocks[block_of(label)];
+            return bb.instructions[label - bb.first_label()];
+        };
+        // the loops of this round have round levels of loops nested in them
+        vector<int> height(forest.loops.size(), 0);
+        for (int l = forest.loops.size() - 1; l >= 0; l--) {
+            for (int c : forest.loops[l].children)
+                height[l] = std::max(height[l], height[c] + 1);
+        }
+        if (std::none_of(height.begin(), height.end(), [&](int h) { return h >= round; }))
+            return;
+
+        unordered_map<long long, vector<long long>> users;          // by register label
+        unordered_map<uint32_t, vector<long long>> variable_reads;  // by variable symbol
+        unordered_set<uint32_t> address_taken;
+        for (const auto& bb : basic_blocks) {
+            for (const auto& inst : bb.instructions) {
+                for (size_t k = 0; k < inst.operands.size(); k++) {
+                    const auto& operand = inst.operands[k];
+                    if (operand.type == Operand::Type::REG)
+                        users[operand.reg_name].push_back(inst.label);
+                    else if (is_scalar(operand) && !(inst.opcode.type == Opcode::Type::MOVE && k == 1))
+                        variable_reads[operand.symbol].push_back(inst.label);
+                    else if (operand.type == Operand::Type::LOCAL_ADDR || operand.type == Operand::Type::GLOBAL_ADDR)
+                        address_taken.insert(operand.symbol);
+                }
+            }
+        }
+        vector<vector<Instruction>> preheaders(forest.loops.size());
+        unordered_map<long long, vector<Instruction>> after;
+
+        for (int l = 0; l < forest.loops.size(); l++) {
+            const auto& loop = forest.loops[l];
+            const int h = loop.header;
+            // the preheader goes before the header, as in licm
+            if (height[l] != round || h == 0 || forest.contains(l, h - 1))
+                continue;
+            bool has_call = false, has_store = false;
+            unordered_map<uint32_t, vector<long long>> moves;
+            for (int b : loop.blocks) {
+                for (const auto& inst : basic_blocks[b].instructions) {
+                    if (inst.opcode.type == Opcode::Type::CALL)
+                        has_call = true;
+                    else if (inst.opcode.type == Opcode::Type::STORE)
+                        has_store = true;
+                    else if (inst.opcode.type == Opcode::Type::MOVE)
+                        moves[inst.operands[1].symbol].push_back(inst.label);
+                }
+            }
+            auto in_loop = [&](long long label) { return forest.contains(l, block_of(label)); };
+
+            unordered_map<uint32_t, BasicIV> basic;
+            for (const auto& [symbol, labels] : moves) {
+                const auto& move = inst_at(labels.front());
+                const auto& source = move.operands[0];
+                if (labels.size() != 1 || !is_scalar(move.operands[1]) || address_taken.count(symbol) > 0 ||
+                    source.type != Operand::Type::REG || !in_loop(source.reg_name))
+                    continue;
+                const auto& update = inst_at(source.reg_name);
+                if (update.operands.size() != 2)
+                    continue;
+                const auto& a = update.operands[0];
+                const auto& b = update.operands[1];
+                auto is_self = [&](const Operand& operand) { return is_scalar(operand) && operand.symbol == symbol; };
+                if (update.opcode.type == Opcode::Type::ADD && is_self(a) && b.type == Operand::Type::CONSTANT)
+                    basic[symbol] = {move.operands[1], b.constant, move.label};
+                else if (update.opcode.type == Opcode::Type::ADD && a.type == Operand::Type::CONSTANT && is_self(b))
+                    basic[symbol] = {move.operands[1], a.constant, move.label};
+                else if (update.opcode.type == Opcode::Type::SUB && is_self(a) && b.type == Operand::Type::CONSTANT)
+                    basic[symbol] = {move.operands[1], -b.constant, move.label};
+            }
+            if (basic.empty())
+                continue;
+
+            // the invariant term an operand holds, -1 if it varies in the loop
+            Terms terms;
+            unordered_map<long long, int> term_of_reg;
+            std::function<int(const Operand&)> term_of = [&](const Operand& operand) -> int {
+                switch (operand.type) {
+                    case Operand::Type::LOCAL_VARIABLE:
+                    case Operand::Type::PARAMETER:
+                        if (moves.count(operand.symbol) > 0 ||
+                            (address_taken.count(operand.symbol) > 0 && (has_store || has_call)))
+                            return -1;
+                        return terms.leaf(operand);
+                    case Operand::Type::GLOBAL_VARIABLE:
+                        if (moves.count(operand.symbol) > 0 || has_store || has_call)
+                            return -1;
+                        return terms.leaf(operand);
+                    case Operand::Type::REG:
+                        break;
+                    case Operand::Type::LABEL:
+                    case Operand::Type::FUNCTION:
+                        return -1;
+                    default:
+                        return terms.leaf(operand);
+                }
+                if (!in_loop(operand.reg_name))
+                    return terms.leaf(operand);
+                auto iter = term_of_reg.find(operand.reg_name);
+                if (iter != term_of_reg.end())
+                    return iter->second;
+                const auto& def = inst_at(operand.reg_name);
+                const auto opcode = def.opcode.type;
+                int t = -1;
+                if (opcode == Opcode::Type::ASSIGN) {
+                    t = term_of(def.operands[0]);
+                } else if (opcode == Opcode::Type::ADD || opcode == Opcode::Type::SUB || opcode == Opcode::Type::MUL) {
+                    int a = term_of(def.operands[0]), b = term_of(def.operands[1]);
+                    if (a >= 0 && b >= 0)
+                        t = terms.node(opcode, a, b);
+                }
+                term_of_reg[operand.reg_name] = t;
+                return t;
+            };
+            // the form an operand holds, if it is linear in a basic induction variable
+            unordered_map<long long, std::optional<Form>> form_of_reg;
+            std::function<std::optional<Form>(const Operand&)> form_of = [&](const Operand& operand) -> std::optional<Form> {
+                if (is_scalar(operand) && basic.count(operand.symbol) > 0)
+                    return Form{operand.symbol, terms.constant(1), terms.constant(0), false};
+                if (operand.type != Operand::Type::REG || !in_loop(operand.reg_name))
+                    return std::nullopt;
+                auto iter = form_of_reg.find(operand.reg_name);
+                if (iter != form_of_reg.end())
+                    return iter->second;
+                const auto& def = inst_at(operand.reg_name);
+                const auto opcode = def.opcode.type;
+                std::optional<Form> form;
+                if (opcode == Opcode::Type::ASSIGN) {
+                    form = form_of(def.operands[0]);
+                } else if (opcode == Opcode::Type::ADD || opcode == Opcode::Type::SUB || opcode == Opcode::Type::MUL) {
+                    auto fa = form_of(def.operands[0]), fb = form_of(def.operands[1]);
+                    if (fa && fb) {
+                        if (opcode != Opcode::Type::MUL && fa->basic == fb->basic)
+                            form = Form{fa->basic, terms.node(opcode, fa->factor, fb->factor),
+                                        terms.node(opcode, fa->base, fb->base), fa->multiplied || fb->multiplied};
+                    } else if (fa || fb) {
+                        // one side varies with v, the other is invariant; for sub, v must be on the left
+                        const auto& f = fa ? *fa : *fb;
+                        const int t = term_of(def.operands[fa ? 1 : 0]);
+                        if (t >= 0 && opcode == Opcode::Type::MUL)
+                            form = Form{f.basic, terms.node(opcode, f.factor, t), terms.node(opcode, f.base, t), true};
+                        else if (t >= 0 && (opcode == Opcode::Type::ADD || fa))
+                            form = Form{f.basic, f.factor, terms.node(opcode, f.base, t), f.multiplied};
+                    }
+                }
+                form_of_reg[operand.reg_name] = form;
+                return form;
+            };
+
+            // The registers of a multiplied form all die once the ones read other
+            // than by another form, the roots, read new variables. Per basic
+            // variable, that saves them and, when nothing else reads v once its
+            // compares are replaced, v's update and move, for two instructions
+            // bumping each new variable
+            struct Group {
+                vector<std::pair<long long, Form>> roots;
+                int dying = 0, multiplications = 0;
+            };
+            map<uint32_t, Group> groups;
+            for (int b : loop.blocks) {
+                for (const auto& inst : basic_blocks[b].instructions) {
+                    if (inst.opcode.info().def != Opcode::DEF_REG)
+                        continue;
+                    auto form = form_of(reg_operand(inst));
+                    if (!form || !form->multiplied)
+                        continue;
+                    auto& group = groups[form->basic];
+                    group.dying++;
+                    if (inst.opcode.type == Opcode::Type::MUL)
+                        group.multiplications++;
+                    const auto& reads = users[inst.label];
+                    if (std::any_of(reads.begin(), reads.end(), [&](long long user) {
+                            return !in_loop(user) || !form_of(reg_operand(inst_at(user)));
+                        }))
+                        group.roots.emplace_back(inst.label, *form);
+                }
+            }
+            // Call f on each read of the register after it in its block, up to the
+            // move to v; returns whether those are all its reads
+            auto for_each_read_after = [&](long long label, long long move, auto f) {
+                auto& instructions = basic_blocks[block_of(label)].instructions;
+                size_t cnt = 0;
+                for (size_t i = label - instructions.front().label + 1; i < instructions.size(); i++) {
+                    auto& user = instructions[i];
+                    if (user.label == move)
+                        break;
+                    if (user.is_branch())
+                        continue;
+                    for (auto& operand : user.operands) {
+                        if (operand.type == Operand::Type::REG && operand.reg_name == label) {
+                            f(operand);
+                            cnt++;
+                        }
+                    }
+                }
+                return cnt == users[label].size();
+            };
+            // the compares linear test replacement rewrites: v against an invariant
+            auto is_test = [&](const Instruction& inst, uint32_t symbol) {
+                if (!in_loop(inst.label) || (inst.opcode.type != Opcode::Type::CMPLT && inst.opcode.type != Opcode::Type::CMPLE))
+                    return false;
+                for (int side = 0; side < 2; side++) {
+                    const auto& operand = inst.operands[side];
+                    if (is_scalar(operand) && operand.symbol == symbol && term_of(inst.operands[1 - side]) >= 0)
+                        return true;
+                }
+                return false;
+            };
+
+            // whether a path from an exit of the loop reads v before a move to it
+            auto live_after = [&](uint32_t symbol) {
+                vector<char> seen(basic_blocks.size(), false);
+                vector<int> stack(loop.exits.begin(), loop.exits.end());
+                for (int b : stack)
+                    seen[b] = true;
+                while (!stack.empty()) {
+                    const int b = stack.back();
+                    stack.pop_back();
+                    bool moved = false;
+                    for (const auto& inst : basic_blocks[b].instructions) {
+                        const auto use = inst.opcode.info().use;
+                        for (size_t k = 0; k < inst.operands.size(); k++) {
+                            const auto& operand = inst.operands[k];
+                            if (is_scalar(operand) && operand.symbol == symbol &&
+                                (use == Opcode::USE_ALL || (use == Opcode::USE_FIRST && k == 0)))
+                                return true;
+                        }
+                        if (inst.opcode.type == Opcode::Type::MOVE && inst.operands[1].symbol == symbol) {
+                            moved = true;
+                            break;
+                        }
+                    }
+                    if (moved)
+                        continue;
+                    for (auto label : basic_blocks[b].successor_labels) {
+                        const int s = idx_of_bb.at(label);
+                        if (!seen[s]) {
+                            seen[s] = true;
+                            stack.push_back(s);
+                        }
+                    }
+                }
+                return false;
+            };
+
+            // the term v holds on entry to the loop: a constant when the one way in moves one to it
+            auto entry_value = [&](const BasicIV& v) {
+                std::optional<int> from;
+                for (auto label : basic_blocks[h].predecessor_labels) {
+                    const int p = idx_of_bb.at(label);
+                    if (forest.contains(l, p))
+                        continue;
+                    if (from)
+                        return terms.leaf(v.variable);
+                    from = p;
+                }
+                const auto& instructions = basic_blocks[*from].instructions;
+                for (auto iter = instructions.rbegin(); iter != instructions.rend(); ++iter) {
+                    if (iter->opcode.type == Opcode::Type::MOVE && iter->operands[1].symbol == v.variable.symbol) {
+                        if (iter->operands[0].type == Operand::Type::CONSTANT)
+                            return terms.constant(iter->operands[0].constant);
+                        break;
+                    }
+                }
+                return terms.leaf(v.variable);
+            };
+
+            // the preheader computes the terms as they are needed, each one once
+            auto& preheader = preheaders[l];
+            vector<std::optional<Operand>> computed;
+            std::function<Operand(int)> compute = [&](int t) -> Operand {
+                computed.resize(terms.size());
+                if (computed[t])
+                    return *computed[t];
+                const auto& term = terms[t];
+                Operand result = term.leaf;
+                if (term.opcode != Opcode::Type::INVALID) {
+                    auto a = compute(term.a), b = compute(term.b);
+                    preheader.push_back(new_instruction(term.opcode, a, b));
+                    result = reg_operand(preheader.back());
+                }
+                computed[t] = result;
+                return result;
+            };
+            for (const auto& [symbol, group] : groups) {
+                if (group.roots.empty())
+                    continue;
+                const auto& v = basic.at(symbol);
+                std::set<std::pair<int, int>> forms;
+                int saved = group.dying;
+                std::optional<Form> test;  // the form the tests compare, of a constant factor > 0
+                for (const auto& [label, form] : group.roots) {
+                    forms.emplace(form.factor, form.base);
+                    if (!for_each_read_after(label, v.move, [](Operand&) {}))
+                        saved--;
+                    if (!test && terms.is_constant(form.factor) && terms.value(form.factor) > 0)
+                        test = form;
+                }
+                const auto update = inst_at(v.move).operands[0].reg_name;
+                const auto& reads = variable_reads[symbol];
+                std::optional<bool> is_live_after;
+                if (users[update].size() == 1 && std::all_of(reads.begin(), reads.end(), [&](long long label) {
+                        const auto& inst = inst_at(label);
+                        if (label == update || (test && is_test(inst, symbol)))
+                            return true;
+                        if (!in_loop(label)) {
+                            if (!is_live_after)
+                                is_live_after = live_after(symbol);
+                            return !*is_live_after;
+                        }
+                        if (inst.opcode.info().def != Opcode::DEF_REG)
+                            return false;
+                        auto form = form_of(reg_operand(inst));
+                        return form && form->multiplied;
+                    }))
+                    saved += 2;
+                if (saved <= 2 * int(forms.size()))
+                    continue;
+                multiplications_reduced_cnt += group.multiplications;
+
+                // one variable per form, set in the preheader and bumped after the move to v
+                map<std::pair<int, int>, Operand> variable_of;
+                for (const auto& [label, form] : group.roots) {
+                    auto key = std::make_pair(form.factor, form.base);
+                    auto iter = variable_of.find(key);
+                    if (iter == variable_of.end()) {
+                        auto variable = new_variable();
+                        moves[variable.symbol].push_back(v.move);
+                        int value = terms.node(Opcode::Type::ADD, form.base,
+                                               terms.node(Opcode::Type::MUL, entry_value(v), form.factor));
+                        Instruction init(next_label++, Opcode::Type::MOVE, symbols);
+                        init.operands.push_back(compute(value));
+                        init.operands.push_back(variable);
+                        preheader.push_back(init);
+                        auto step = compute(terms.node(Opcode::Type::MUL, form.factor, terms.constant(v.step)));
+                        auto bump = new_instruction(Opcode::Type::ADD, variable, step);
+                        after[v.move].push_back(bump);
+                        Instruction move(next_label++, Opcode::Type::MOVE, symbols);
+                        move.operands.push_back(reg_operand(bump));
+                        move.operands.push_back(variable);
+                        after[v.move].push_back(move);
+                        iter = variable_of.emplace(key, variable).first;
+                    }
+                    const auto& variable = iter->second;
+                    auto& def = inst_at(label);
+                    def.opcode.type = Opcode::Type::ASSIGN;
+                    def.operands.clear();
+                    def.operands.push_back(variable);
+                    // up to the move to v, the variable still holds the value
+                    for_each_read_after(label, v.move, [&](Operand& operand) { operand = variable; });
+                }
+
+                // linear test replacement: v < n becomes base + v * k < base + n * k
+                if (!test)
+                    continue;
+                const auto& variable = variable_of.at(std::make_pair(test->factor, test->base));
+                for (auto label : reads) {
+                    auto& inst = inst_at(label);
+                    if (!is_test(inst, symbol))
+                        continue;
+                    const int side = is_scalar(inst.operands[0]) && inst.operands[0].symbol == symbol ? 0 : 1;
+                    const int n = term_of(inst.operands[1 - side]);
+                    const int bound = terms.node(Opcode::Type::ADD, test->base, terms.node(Opcode::Type::MUL, n, test->factor));
+                    inst.operands[1 - side] = compute(bound);
+                    inst.operands[side] = variable;
+                }
+            }
+        }
+        if (after.empty())
+            continue;
+        auto insts = layout(preheaders, after, {});
+        insts.front().operands[0].constant = local_var_size;
+        relabel(insts, symbols);
+    }
+}
@@ -0,0 +1,140 @@
+#include <algorithm>
+
+#include "ir.h"
+vector<Instruction> Function::layout(const vector<vector<Instruction>>& preheaders,
+                                     const unordered_map<long long, vector<Instruction>>& after,
+                                     const unordered_set<long long>& dropped) {
+    const auto& forest = loops();
+    vector<int> loop_of_header(basic_blocks.size(), -1);
+    for (int l = 0; l < preheaders.size(); l++) {
+        if (!preheaders[l].empty())
+            loop_of_header[forest.loops[l].header] = l;
+    }
+    // A branch from outside a loop into its header moves to the preheader;
+    // any other branch goes to the first instruction left in its target block
+    auto new_target = [&](int from, long long label) {
+        const int b = idx_of_bb.at(label);
+        const int l = loop_of_header[b];
+        if (l >= 0 && !forest.contains(l, from))
+            return preheaders[l].front().label;
+        for (const auto& inst : basic_blocks[b].instructions) {
+            if (dropped.count(inst.label) == 0)
+                return inst.label;
+        }
+        return label;
+    };
+    vector<Instruction> insts;
+    for (int b = 0; b < basic_blocks.size(); b++) {
+        if (loop_of_header[b] >= 0) {
+            const auto& preheader = preheaders[loop_of_header[b]];
+            insts.insert(insts.end(), preheader.begin(), preheader.end());
+        }
+        for (const auto& inst : basic_blocks[b].instructions) {
+            if (dropped.count(inst.label) == 0)
+                insts.push_back(inst);
+            auto iter = after.find(inst.label);
+            if (iter != after.end())
+                insts.insert(insts.end(), iter->second.begin(), iter->second.end());
+        }
+        auto& last = insts.back();
+        if (last.is_branch())
+            last.operands.back().inst_label = new_target(b, last.branch_target_label());
+    }
+    return insts;
+}
+
+void Function::relabel(vector<Instruction>& insts, const SymbolTable& symbols, long long first) {
+    assert(insts.front().opcode.type == Opcode::Type::ENTER);
+    if (first < 0)
+        first = id;
+    // the labels the instructions had, old ones and new ones alike, map to their positions
+    unordered_map<long long, long long> new_label;
+    new_label.reserve(insts.size());
+    for (size_t i = 0; i < insts.size(); i++)
+        new_label[insts[i].label] = first + i;
+    for (auto& inst : insts) {
+        inst.label = new_label.at(inst.label);
+        inst.is_block_leader = false;
+        inst.is_branch_target = false;
+        for (auto& operand : inst.operands) {
+            if (operand.type == Operand::Type::REG)
+                operand.reg_name = new_label.at(operand.reg_name);
+            else if (operand.type == Operand::Type::LABEL)
+                operand.inst_label = new_label.at(operand.inst_label);
+        }
+    }
+    // registers keep their symbols: a symbol names the value, whatever its label
+    auto resource = basic_blocks.get_allocator().resource();
+    Function rebuilt(insts.data(), insts.data() + insts.size(), symbols, resource, is_main);
+    // a variable no longer named by any instruction still holds its place in the frame: a local
+    // dropped here would widen the one below it, and a parameter dropped would change the arity
+    auto keep = [](vector<Variable>& now, const vector<Variable>& before) {
+        for (const auto& v : before) {
+            if (std::none_of(now.begin(), now.end(), [&](const Variable& w) { return w.address == v.address; }))
+                now.push_back(v);
+        }
+        std::sort(now.begin(), now.end());
+    };
+    keep(rebuilt.local_variables, local_variables);
+    for (size_t i = 0; i < rebuilt.local_variables.size(); i++) {
+        rebuilt.local_variables[i].size = i + 1 < rebuilt.local_variables.size()
+                                              ? rebuilt.local_variables[i + 1].address - rebuilt.local_variables[i].address
+                                              : -rebuilt.local_variables[i].address;
+    }
+    std::reverse(rebuilt.local_variables.begin(), rebuilt.local_variables.end());
+    keep(rebuilt.params, params);
+    std::reverse(rebuilt.params.begin(), rebuilt.params.end());
+    rebuilt.constant_propagated_cnt = constant_propagated_cnt;
+    rebuilt.statement_eliminated_cnt = statement_eliminated_cnt;
+    rebuilt.expressions_eliminated_cnt = expressions_eliminated_cnt;
+    rebuilt.instructions_hoisted_cnt = instructions_hoisted_cnt;
+    rebuilt.multiplications_reduced_cnt = multiplications_reduced_cnt;
+    rebuilt.calls_inlined_cnt = calls_inlined_cnt;
+    rebuilt.blocks_removed_cnt = blocks_removed_cnt;
+    rebuilt.branches_removed_cnt = branches_removed_cnt;
+    rebuilt.dataflow_iterations = dataflow_iterations;
+    *this = std::move(rebuilt);
+}
+
+void Program::advance_next_label() {
+    for (const auto& func : functions)
+        next_label = std::max(next_label, func.basic_blocks.back().last_label() + 1);
+}
+
+// Each function but the first starts right after the one before it, or
+// after the entrypc before main
+void Program::renumber(long long first) {
+    unordered_map<long long, long long> new_id;
+    long long next = first >= 0 ? first : functions.empty() ? 0 : functions.front().id;
+    for (const auto& func : functions) {
+        if (func.is_main && &func != &functions.front())
+            next++;
+        new_id[func.id] = next;
+        next += func.basic_blocks.back().last_label() - func.id + 1;
+    }
+    auto body = [&](size_t i) {
+        auto& func = functions[i];
+        for (auto& bb : func.basic_blocks) {
+            for (auto& inst : bb.instructions) {
+                if (inst.opcode.type != Opcode::Type::CALL)
+                    continue;
+                auto iter = new_id.find(inst.operands[0].function_id);
+                if (iter != new_id.end())
+                    inst.operands[0].function_id = iter->second;
+            }
+        }
+        if (new_id.at(func.id) == func.id)
+            return;
+        vector<Instruction> insts;
+        for (const auto& bb : func.basic_blocks)
+            insts.insert(insts.end(), bb.instructions.begin(), bb.instructions.end());
+        func.relabel(insts, symbols, new_id.at(func.id));
+    };
+    // relabel rebuilds blocks, which the arenas must not see concurrently
+    if (arenas.empty()) {
+        for_each_function(body);
+    } else {
+        for (size_t i = 0; i < functions.size(); i++)
+            body(i);
+    }
+}
@@ -0,0 +1,150 @@
+#include <algorithm>
+
+#include "ir.h"
+namespace {
+bool is_pure(const Instruction& inst) {
+    switch (inst.opcode.type) {
+        case Opcode::Type::ADD:
+        case Opcode::Type::SUB:
+        case Opcode::Type::MUL:
+        case Opcode::Type::NEG:
+        case Opcode::Type::CMPEQ:
+        case Opcode::Type::CMPLE:
+        case Opcode::Type::CMPLT:
+        case Opcode::Type::ASSIGN:
+            return true;
+        case Opcode::Type::DIV:
+        case Opcode::Type::MOD: {
+            // hoisted, it runs even when the loop does not: only divisors that cannot trap
+            const auto& divisor = inst.operands[1];
+            return divisor.type == Operand::Type::CONSTANT && divisor.constant != 0 && divisor.constant != -1;
+        }
+        default:
+            return false;
+    }
+}
+}  // namespace
+
+// Every round hoists the instructions invariant in the innermost loop
+// around them into a preheader of that loop, which lies in the next loop
+// out, so an instruction invariant in several loops climbs one per round.
+// A preheader holds only hoisted instructions and replaces nothing: it is
+// inserted right before the header, which the code before it falls into,
+// and the branches into the header from outside the loop move to it. The
+// hoisted instructions leave their blocks, so the function keeps its size
+// and relabel() keeps every other function's labels.
+void Function::licm(const SymbolTable& symbols) {
+    while (true) {
+        const auto& forest = loops();
+        auto& chains = this->chains();
+        const auto label_0 = chains.label_0;
+        auto inst_at = [&](long long label) -> const Instruction& {
+            const auto& bb = basic_blocks[chains.block_of_inst[label - label_0]];
+            return bb.instructions[label - bb.first_label()];
+        };
+
+        // variables a store or a call may write through their address
+        unordered_set<uint32_t> address_taken;
+        for (const auto& bb : basic_blocks) {
+            for (const auto& inst : bb.instructions) {
+                for (const auto& operand : inst.operands) {
+                    if (operand.type == Operand::Type::LOCAL_ADDR || operand.type == Operand::Type::GLOBAL_ADDR)
+                        address_taken.insert(operand.symbol);
+                }
+            }
+        }
+        vector<vector<long long>> hoisted(forest.loops.size());  // per loop, in the order found
+        vector<size_t> kept(basic_blocks.size());  // per block, the instructions not hoisted
+        for (int b = 0; b < basic_blocks.size(); b++)
+            kept[b] = basic_blocks[b].instructions.size();
+        unordered_set<long long> is_hoisted;
+        for (int l = 0; l < forest.loops.size(); l++) {
+            const auto& loop = forest.loops[l];
+            const int h = loop.header;
+            // the preheader goes before the header, so the block laid out before
+            // it must be the way in, not a block of the loop falling into it
+            if (h == 0 || forest.contains(l, h - 1))
+                continue;
+            // what the loop may write: variables by move, memory by store or call
+            bool has_call = false, has_store = false;
+            unordered_set<uint32_t> written;
+            for (int b : loop.blocks) {
+                for (const auto& inst : basic_blocks[b].instructions) {
+                    if (inst.opcode.type == Opcode::Type::CALL)
+                        has_call = true;
+                    else if (inst.opcode.type == Opcode::Type::STORE)
+                        has_store = true;
+                    else if (inst.opcode.type == Opcode::Type::MOVE)
+                        written.insert(inst.operands[1].symbol);
+                }
+            }
+            auto is_invariant = [&](const Operand& operand) {
+                switch (operand.type) {
+                    case Operand::Type::LOCAL_VARIABLE:
+                    case Operand::Type::PARAMETER:
+                        return written.count(operand.symbol) == 0 &&
+                               (address_taken.count(operand.symbol) == 0 || !(has_store || has_call));
+                    case Operand::Type::GLOBAL_VARIABLE:
+                        // other functions may take its address and pass it on
+                        return written.count(operand.symbol) == 0 && !(has_store || has_call);
+                    case Operand::Type::REG:
+                        return is_hoisted.count(operand.reg_name) > 0 ||
+                               !forest.contains(l, chains.block_of_inst[operand.reg_name - label_0]);
+                    default:
+                        return true;
+                }
+            };
+            // an address within one variable: its base, plus field offsets
+            std::function<bool(const Operand&)> is_variable_address = [&](const Operand& operand) {
+                if (operand.type != Operand::Type::REG)
+                    return false;
+                const auto& def = inst_at(operand.reg_name);
+                if (def.opcode.type != Opcode::Type::ADD)
+                    return false;
+                const auto& offset = def.operands[1];
+                if (offset.type == Operand::Type::GP || offset.type == Operand::Type::FP)
+                    return true;
+                return offset.type == Operand::Type::FIELD_OFFSET && is_variable_address(def.operands[0]);
+            };
+            auto is_hoistable = [&](const Instruction& inst) {
+                if (is_hoisted.count(inst.label) > 0)
+                    return false;
+                if (inst.opcode.type == Opcode::Type::LOAD) {
+                    // safe: nothing in the loop writes memory, and the address cannot fault
+                    if (has_store || has_call || !is_variable_address(inst.operands[0]))
+                        return false;
+                } else if (!is_pure(inst)) {
+                    return false;
+                }
+                return std::all_of(inst.operands.begin(), inst.operands.end(), is_invariant);
+            };
+            for (bool changed = true; changed;) {
+                changed = false;
+                for (int b : loop.blocks) {
+                    if (forest.loop_of[b] != l)
+                        continue;
+                    // one instruction stays, so that no block is left empty
+                    for (const auto& inst : basic_blocks[b].instructions) {
+                        if (kept[b] > 1 && is_hoistable(inst)) {
+                            hoisted[l].push_back(inst.label);
+                            is_hoisted.insert(inst.label);
+                            kept[b]--;
+                            changed = true;
+                        }
+                    }
+                }
+            }
+        }
+        if (is_hoisted.empty())
+            return;
+
+        vector<vector<Instruction>> preheaders(forest.loops.size());
+        for (int l = 0; l < forest.loops.size(); l++) {
+            for (auto label : hoisted[l])
+                preheaders[l].push_back(inst_at(label));
+        }
+        auto insts = layout(preheaders, {}, is_hoisted);
+        instructions_hoisted_cnt += is_hoisted.size();
+        relabel(insts, symbols);
+    }
+}
@@ -1,8 +1,38 @@
+#include <sys/resource.h>
+
+#include <charconv>
+#include <chrono>
 #include <iostream>
 #include <string>
 
+#include "bitset.h"
 #include "ir.h"
 
+// -time: report the wall time of each phase and the peak RSS on stderr
+class PhaseTimer {
+   private:
+    bool enabled;
+    std::chrono::steady_clock::time_point start;
+
+   public:
+    PhaseTimer(bool _enabled) : enabled(_enabled), start(std::chrono::steady_clock::now()){};
+    void lap(const char* phase) {
+        if (!enabled)
+            return;
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::duration<double, std::milli> ms = now - start;
+        std::cerr << phase << ": " << ms.count() << " ms" << std::endl;
+        start = now;
+    }
+    ~PhaseTimer() {
+        if (!enabled)
+            return;
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        std::cerr << "peak rss: " << usage.ru_maxrss << " KB" << std::endl;
+    }
+};
+
 int main(int argc, char** argv) {
     std::vector<std::string> all_args;
     if (argc > 1) {
@@ -10,41 +40,169 @@ int main(int argc, char** argv) {
     }
     bool do_dse = false;
     bool do_scp = false;
+    bool do_ipcp = false;
+    bool do_gvn = false;
+    bool do_licm = false;
+    bool do_ivs = false;
+    bool do_inline = false;
+    bool do_simplify_cfg = false;
     bool do_rep = false;
+    bool do_time = false;
+    bool use_getline = false;
+    bool use_arena = false;
+    bool use_stream = false;
+    int jobs = 1;
+    bool do_dataflow_stats = false;
     string backend;
-    for (auto& s : all_args) {
+    // the thread count of -jobs, or 0 when it is not a positive number
+    auto parse_jobs = [](const string& value) {
+        int n = 0;
+        auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), n);
+        return ec == std::errc() && end == value.data() + value.size() && n >= 1 ? n : 0;
+    };
+    for (size_t i = 0; i < all_args.size(); i++) {
+        auto& s = all_args[i];
         if (s.find("dse") != string::npos)
             do_dse = true;
         if (s.find("scp") != string::npos)
             do_scp = true;
+        // scp across calls; it needs the whole program, so -stream runs plain scp
+        if (s.find("ipcp") != string::npos)
+            do_scp = do_ipcp = true;
+        // value numbering, after scp; -stream ignores it
+        if (s.find("gvn") != string::npos)
+            do_gvn = true;
+        // loop-invariant code motion, after gvn and before dse; -stream ignores it
+        if (s.find("licm") != string::npos)
+            do_licm = true;
+        // induction variable strength reduction, after licm and before dse; -stream ignores it
+        if (s.find("ivs") != string::npos)
+            do_ivs = true;
+        // inlining, first, so that the other passes see the enlarged functions; -stream ignores it
+        if (s.find("inline") != string::npos)
+            do_inline = true;
+        // CFG cleanup, right after scp, with its counts under -backend=rep; -stream ignores it
+        if (s.find("simplifycfg") != string::npos)
+            do_simplify_cfg = true;
         if (s.find("backend") != string::npos) {
             backend = s.substr(s.find('=') + 1);
         }
+        if (s == "-time")
+            do_time = true;
+        // the line-by-line reader, kept as a baseline for bench-parse.sh
+        if (s == "-parser=getline")
+            use_getline = true;
+        // allocate the whole IR from one monotonic arena
+        if (s == "-arena")
+            use_arena = true;
+        // build, optimize and emit one function at a time
+        if (s == "-stream")
+            use_stream = true;
+        // parse, build, optimize and emit the functions on N threads
+        if (s.rfind("-jobs=", 0) == 0 && (jobs = parse_jobs(s.substr(6))) == 0) {
+            std::cerr << "-jobs takes a positive number of threads, not " << s.substr(6) << std::endl;
+            return 1;
+        }
+        if (s == "--jobs") {
+            if (i + 1 == all_args.size()) {
+                std::cerr << "--jobs takes a number of threads" << std::endl;
+                return 1;
+            }
+            if ((jobs = parse_jobs(all_args[++i])) == 0) {
+                std::cerr << "--jobs takes a positive number of threads, not " << all_args[i] << std::endl;
+                return 1;
+            }
+        }
+        if (s == "-dataflow-stats")
+            do_dataflow_stats = true;
+        // force the scalar, avx2 or avx512 set kernels of the dataflow solver
+        if (s.rfind("-bitset=", 0) == 0 && !select_bitset_kernels(s.substr(8))) {
+            std::cerr << "bitset kernels " << s.substr(8) << " not available" << std::endl;
+            return 1;
+        }
     }
     if (backend.find("rep") != string::npos) {
         do_rep = true;
     }
 
+    PhaseTimer timer(do_time);
+    SymbolTable symbols;
+    if (use_stream) {
+        auto program = Program(std::move(symbols));
+        if (!program.stream(0, do_scp, do_dse, do_rep, backend, std::cout)) {
+            std::cerr << "-stream takes text input only" << std::endl;
+            return 1;
+        }
+        timer.lap("stream");
+        return 0;
+    }
     vector<Instruction> instructions;
-    for (std::string line; std::getline(std::cin, line);) {
-        if (line.find("instr") != string::npos)
-            instructions.emplace_back(line);
+    if (use_getline) {
+        for (std::string line; std::getline(std::cin, line);) {
+            if (line.find("instr") != string::npos)
+                instructions.emplace_back(line, symbols);
+        }
+    } else {
+        InputBuffer input(0);
+        if (is_binary_ir(input.text())) {
+            string error;
+            instructions = parse_binary_instructions(input.text(), symbols, error);
+            if (!error.empty()) {
+                std::cerr << "binary IR: " << error << std::endl;
+                return 1;
+            }
+        } else {
+            instructions = parse_instructions(input.text(), symbols, jobs);
+        }
+    }
+    timer.lap("parse");
+    auto program = Program(instructions, std::move(symbols), use_arena, jobs);
+    timer.lap("build");
+    if (do_inline) {
+        program.inline_calls();
+        if (do_rep) program.inline_report();
     }
-    auto program = Program(instructions);
     if (do_scp) {
-        program.scp();
+        if (do_ipcp)
+            program.ipcp();
+        else
+            program.scp();
         if (do_rep) program.scp_report();
     }
+    if (do_simplify_cfg) {
+        program.simplify_cfg();
+        if (do_rep) program.simplify_cfg_report();
+    }
+    if (do_gvn) {
+        program.gvn();
+        if (do_rep) program.gvn_report();
+    }
+    if (do_licm) {
+        program.licm();
+        if (do_rep) program.licm_report();
+    }
+    if (do_ivs) {
+        program.reduce_strength();
+        if (do_rep) program.ivs_report();
+    }
     if (do_dse) {
         program.dse();
         if(do_rep) program.dse_report();
     }
+    if (do_dataflow_stats)
+        program.dataflow_report();
+    timer.lap("optimize");
     if(backend[0]=='c'&&backend.size()==1)
         std::cout << program.ccode();
+    else if (backend == "c-goto")
+        std::cout << program.ccode(false);
+    else if (backend == "cfg-analysis")
+        std::cout << program.cfg_analysis();
     else if(backend.find("cfg")!=string::npos)
         std::cout << program.cfg();
     else if(backend.find("3addr")!=string::npos)
         std::cout<<program.icode()<<std::endl;
-    
+    timer.lap("emit");
+
     return 0;
 }
\ No newline at end of file
@@ -1,75 +1,91 @@
-#include <algorithm>
-
 #include "ir.h"
-map<Opcode::Type, string> Opcode::opcode_name = {
-    {INVALID, "invalid"},
-    {ADD, "add"},
-    {SUB, "sub"},
-    {MUL, "mul"},
-    {DIV, "div"},
-    {MOD, "mod"},
-    {NEG, "neg"},
-    {CMPEQ, "cmpeq"},
-    {CMPLE, "cmple"},
-    {CMPLT, "cmplt"},
-    {BR, "br"},
-    {BLBC, "blbc"},
-    {BLBS, "blbs"},
-    {LOAD, "load"},
-    {STORE, "store"},
-    {MOVE, "move"},
-    {READ, "read"},
-    {WRITE, "write"},
-    {WRL, "wrl"},
-    {PARAM, "param"},
-    {ENTER, "enter"},
-    {ENTRYPC, "entrypc"},
-    {CALL, "call"},
-    {RET, "ret"},
-    {NOP, "nop"},
-    {END, "end"},
-    {ASSIGN,"assign"}};
-
-map<Opcode::Type, int> Opcode::operand_cnt = {
-    {INVALID, 0},
-    {ADD, 2},
-    {SUB, 2},
-    {MUL, 2},
-    {DIV, 2},
-    {MOD, 2},
-    {NEG, 1},
-    {CMPEQ, 2},
-    {CMPLE, 2},
-    {CMPLT, 2},
-    {BR, 1},
-    {BLBC, 2},
-    {BLBS, 2},
-    {LOAD, 1},
-    {STORE, 2},
-    {MOVE, 2},
-    {READ, 0},
-    {WRITE, 1},
-    {WRL, 0},
-    {PARAM, 1},
-    {ENTER, 1},
-    {ENTRYPC, 0},
-    {CALL, 1},
-    {RET, 1},
-    {NOP, 0},
-    {END, 0},
-    {ASSIGN,1}};
 
-//match input with opcode to determine type
-Opcode::Opcode(const string& s) : type(Opcode::Type::INVALID) {
-    for (int i = 0; i < Opcode::Type::END; i++) {
-        if (s.find(Opcode::opcode_name[Opcode::Type(i)]) != string::npos) {
-            this->type = Opcode::Type(i);
+// Dispatch on the length and one distinguishing character,
+// then confirm with a single comparison against the descriptor name
+Opcode::Type Opcode::from_name(string_view s) {
+    Type t = INVALID;
+    switch (s.size()) {
+        case 2:
+            t = BR;
+            break;
+        case 3:
+            switch (s[0]) {
+                case 'a':
+                    t = ADD;
+                    break;
+                case 's':
+                    t = SUB;
+                    break;
+                case 'm':
+                    t = s[1] == 'u' ? MUL : MOD;
+                    break;
+                case 'd':
+                    t = DIV;
+                    break;
+                case 'n':
+                    t = s[1] == 'e' ? NEG : NOP;
+                    break;
+                case 'w':
+                    t = WRL;
+                    break;
+                case 'r':
+                    t = RET;
+                    break;
+                case 'e':
+                    t = END;
+                    break;
+            }
+            break;
+        case 4:
+            switch (s[0]) {
+                case 'b':
+                    t = s[3] == 'c' ? BLBC : BLBS;
+                    break;
+                case 'l':
+                    t = LOAD;
+                    break;
+                case 'm':
+                    t = MOVE;
+                    break;
+                case 'r':
+                    t = READ;
+                    break;
+                case 'c':
+                    t = CALL;
+                    break;
+            }
+            break;
+        case 5:
+            switch (s[0]) {
+                case 'c':
+                    t = s[3] == 'e' ? CMPEQ : (s[4] == 'e' ? CMPLE : CMPLT);
+                    break;
+                case 's':
+                    t = STORE;
+                    break;
+                case 'w':
+                    t = WRITE;
+                    break;
+                case 'p':
+                    t = PARAM;
+                    break;
+                case 'e':
+                    t = ENTER;
+                    break;
+            }
+            break;
+        case 6:
+            t = ASSIGN;
+            break;
+        case 7:
+            t = ENTRYPC;
             break;
-        }
     }
-    assert(s.find(Opcode::opcode_name[this->type]) != string::npos);
+    if (s != descriptors[t].name)
+        t = INVALID;
 #ifdef OPCODE_DEBUG
     std::cout << "handling opcode " << s << " ";
-    std::cout << Opcode::opcode_name[this->type] << std::endl;
+    std::cout << descriptors[t].name << std::endl;
 #endif
+    return t;
 }
@@ -16,82 +16,126 @@ map<Operand::Type, string> Operand::type_name = {
     {PARAMETER, "parameter"},
     {GLOBAL_VARIABLE, "variable produced by optimization,must be global"}};
 
-Operand::Operand(const string& s, bool is_function) : type(INVALID), constant(0), variable_name("") {
-    if (s.find('(') != string::npos) {
+Operand::Operand(string_view s, SymbolTable& symbols, bool is_function) : Operand() {
+    // Split the text into the csir.h form, the name and the value,
+    // and let the form constructor classify it
+    unsigned char form;
+    uint32_t name = 0;
+    long long value = 0;
+    if (s.find('(') != string_view::npos) {
         assert(s[0] == '(' && s[s.size() - 1] == ')');
-        this->type = Operand::Type::REG;
-
+        form = CSIRReg;
         // Convert the string inside ( ) to longlong
-        this->reg_name = atoll(s.substr(1, s.size() - 2).c_str());
-    } else if (s.find('[') != string::npos) {
+        value = to_ll(s.substr(1, s.size() - 2));
+    } else if (s.find('[') != string_view::npos) {
         assert(s[0] == '[' && s[s.size() - 1] == ']');
-        if (is_function) {
-            this->type = Operand::Type::FUNCTION;
-            this->function_id = atoll(s.substr(1, s.size() - 2).c_str());
-        } else {
-            this->type = Operand::Type::LABEL;
-            this->inst_label = atoll(s.substr(1, s.size() - 2).c_str());
-        }
-    } else if (s.find("base") != string::npos) {
+        form = CSIRLabel;
+        value = to_ll(s.substr(1, s.size() - 2));
+    } else if (s.find("base") != string_view::npos) {
         auto sharp_idx = s.find('#');
-        assert(sharp_idx != string::npos);
-        //this->type = Operand::Type::ADDR_OFFSET;
-        this->offset = atoll(s.substr(sharp_idx + 1).c_str());
-        if (this->offset > 8192)
-            this->type = Operand::Type::GLOBAL_ADDR;
-        else if (this->offset < 0)
-            this->type = Operand::Type::LOCAL_ADDR;
-        auto base_idx = s.find("_base");
-        this->variable_name = s.substr(0, base_idx);
-    } else if (s.find("offset") != string::npos) {
+        assert(sharp_idx != string_view::npos);
+        form = CSIRBase;
+        value = to_ll(s.substr(sharp_idx + 1));
+        name = symbols.intern_name(s.substr(0, s.find("_base")));
+    } else if (s.find("offset") != string_view::npos) {
         auto sharp_idx = s.find('#');
-        assert(sharp_idx != string::npos);
-        this->type = Operand::Type::FIELD_OFFSET;
-        this->offset = atoll(s.substr(sharp_idx + 1).c_str());
-        auto offset_idex = s.find("_offset");
-        this->variable_name = s.substr(0, offset_idex);
-    } else if (s.find('#') != string::npos) {
+        assert(sharp_idx != string_view::npos);
+        form = CSIRField;
+        value = to_ll(s.substr(sharp_idx + 1));
+        name = symbols.intern_name(s.substr(0, s.find("_offset")));
+    } else if (s.find('#') != string_view::npos) {
         auto sharp_idx = s.find('#');
-        //this->type = Operand::Type::LOCAL_VARIABLE;
-        this->offset = atoll(s.substr(sharp_idx + 1).c_str());
-        if (this->offset < 0)
-            this->type = Operand::Type::LOCAL_VARIABLE;
-        else
-            this->type = Operand::Type::PARAMETER;
-        this->variable_name = s.substr(0, sharp_idx);
-    } else if (s.find("GP") != string::npos) {
-        this->type = Operand::Type::GP;
-    } else if (s.find("FP") != string::npos) {
-        this->type = Operand::Type::FP;
+        form = CSIRVar;
+        value = to_ll(s.substr(sharp_idx + 1));
+        name = symbols.intern_name(s.substr(0, sharp_idx));
+    } else if (s.find("GP") != string_view::npos) {
+        form = CSIRGP;
+    } else if (s.find("FP") != string_view::npos) {
+        form = CSIRFP;
     } else {
         // Does not contain #, [, (, so it must be a constant
-        this->type = Operand::Type::CONSTANT;
-        this->constant = atoll(s.c_str());
+        form = CSIRConst;
+        value = to_ll(s);
     }
+    *this = Operand(form, name, value, symbols, is_function);
 #ifdef OPERAND_DEBUG
     std::cout << "  "
               << "handling operand " << s;
-    std::cout << "  " << Operand::type_name[this->type] << " " << this->offset << "   " << this->variable_name << std::endl;
+    std::cout << "  " << Operand::type_name[this->type] << " " << this->offset << "   " << symbols.name(this->symbol) << std::endl;
 #endif
 }
 
-string Operand::ccode() const {
+Operand::Operand(unsigned char form, uint32_t name, long long value, SymbolTable& symbols, bool is_function)
+    : type(INVALID), symbol(SymbolTable::NONE), constant(0) {
+    switch (form) {
+        case CSIRReg:
+            this->type = Operand::Type::REG;
+            this->reg_name = value;
+            this->symbol = symbols.intern_reg(this->reg_name);
+            break;
+        case CSIRLabel:
+            if (is_function) {
+                this->type = Operand::Type::FUNCTION;
+                this->function_id = value;
+            } else {
+                this->type = Operand::Type::LABEL;
+                this->inst_label = value;
+            }
+            break;
+        case CSIRBase:
+            //this->type = Operand::Type::ADDR_OFFSET;
+            this->offset = value;
+            if (this->offset > 8192)
+                this->type = Operand::Type::GLOBAL_ADDR;
+            else if (this->offset < 0)
+                this->type = Operand::Type::LOCAL_ADDR;
+            this->symbol = symbols.intern(name, this->offset, SymbolTable::STORAGE);
+            break;
+        case CSIRField:
+            this->type = Operand::Type::FIELD_OFFSET;
+            this->offset = value;
+            this->symbol = symbols.intern(name, this->offset, SymbolTable::FIELD);
+            break;
+        case CSIRVar:
+            //this->type = Operand::Type::LOCAL_VARIABLE;
+            this->offset = value;
+            if (this->offset < 0)
+                this->type = Operand::Type::LOCAL_VARIABLE;
+            else
+                this->type = Operand::Type::PARAMETER;
+            this->symbol = symbols.intern(name, this->offset, SymbolTable::STORAGE);
+            break;
+        case CSIRGP:
+            this->type = Operand::Type::GP;
+            break;
+        case CSIRFP:
+            this->type = Operand::Type::FP;
+            break;
+        case CSIRConst:
+            this->type = Operand::Type::CONSTANT;
+            this->constant = value;
+            break;
+        default:
+            assert(false);
+    }
+}
+
+string Operand::ccode(const SymbolTable& symbols, const RegisterSlots& regs) const {
     std::stringstream tmp;
     switch (this->type) {
         case Operand::Type::FP:
         case Operand::Type::GP:
             return "0";
         case Operand::Type::REG:
-            tmp << "REG[" << this->reg_name << "]";
-            return tmp.str();
+            return regs.name(this->reg_name);
         case Operand::Type::GLOBAL_VARIABLE:
         case Operand::Type::LOCAL_VARIABLE:
         case Operand::Type::PARAMETER:
-            tmp << this->variable_name;
+            tmp << symbols.name(this->symbol);
             return tmp.str();
         case Operand::Type::GLOBAL_ADDR:
         case Operand::Type::LOCAL_ADDR:
-            tmp << "(long)(&" << this->variable_name << ")";
+            tmp << "(long)(&" << symbols.name(this->symbol) << ")";
             return tmp.str();
         case Operand::Type::FUNCTION:
             tmp << "function_" << this->function_id;
@@ -108,7 +152,7 @@ string Operand::ccode() const {
     return tmp.str();
 }
 
-string Operand::icode() const {
+string Operand::icode(const SymbolTable& symbols) const {
     std::stringstream tmp;
     switch (this->type) {
         case Operand::Type::FP:
@@ -121,17 +165,17 @@ string Operand::icode() const {
         case Operand::Type::GLOBAL_VARIABLE:
         case Operand::Type::LOCAL_VARIABLE:
         case Operand::Type::PARAMETER:
-            tmp << this->variable_name << "#" << this->offset;
+            tmp << symbols.name(this->symbol) << "#" << this->offset;
             return tmp.str();
         case Operand::Type::GLOBAL_ADDR:
         case Operand::Type::LOCAL_ADDR:
-            tmp << this->variable_name << "_base#" << this->offset;
+            tmp << symbols.name(this->symbol) << "_base#" << this->offset;
             return tmp.str();
         case Operand::Type::FUNCTION:
             tmp << "[" << this->function_id << "]";
             return tmp.str();
         case Operand::Type::FIELD_OFFSET:
-            tmp << this->variable_name << "_offset#" << this->offset;
+            tmp << symbols.name(this->symbol) << "_offset#" << this->offset;
             return tmp.str();
         case Operand::Type::CONSTANT:
             tmp << this->constant;
@@ -154,4 +198,15 @@ bool Operand::is_local() const {
 }
 bool Operand::is_reg() const {
     return type == Type::REG;
+}
+bool Operand::is_value() const {
+    switch (type) {
+        case Type::REG:
+        case Type::LOCAL_VARIABLE:
+        case Type::GLOBAL_VARIABLE:
+        case Type::PARAMETER:
+            return true;
+        default:
+            return false;
+    }
 }
\ No newline at end of file
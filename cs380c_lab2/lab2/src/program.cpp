@@ -1,18 +1,22 @@
 #include <algorithm>
+#include <iterator>
 
 #include "ir.h"
-void Program::scan_global_variables(vector<Instruction>& instrs) {
+#include "parallel.h"
+void Program::scan_global_variables(const Instruction* first, const Instruction* last, vector<Variable>& out) const {
     // Scan all instructions in turn,
     // and save the global variables that appear in the instructions to the vector,
     // so that the addresses are arranged from low to high*/
-    for (const auto& inst : instrs) {
-        if (inst.operands.size() == 2 && inst.operands[1].type == Operand::Type::GP) {
-            assert(inst.opcode.type == Opcode::Type::ADD);
-            assert(inst.operands[0].type == Operand::Type::GLOBAL_ADDR);
-            global_variables.emplace_back(inst.operands[0].variable_name, inst.operands[0].offset);
+    for (auto inst = first; inst != last; ++inst) {
+        if (inst->operands.size() == 2 && inst->operands[1].type == Operand::Type::GP) {
+            assert(inst->opcode.type == Opcode::Type::ADD);
+            assert(inst->operands[0].type == Operand::Type::GLOBAL_ADDR);
+            out.emplace_back(symbols.name(inst->operands[0].symbol), inst->operands[0].offset);
         }
     }
+}
 
+void Program::layout_global_variables() {
     // unique
     std::sort(global_variables.begin(), global_variables.end());
     auto iter = std::unique(global_variables.begin(), global_variables.end());
@@ -31,26 +35,64 @@ void Program::scan_global_variables(vector<Instruction>& instrs) {
     std::reverse(global_variables.begin(), global_variables.end());
 }
 
-Program::Program(vector<Instruction>& insts) : instruction_cnt(insts.size()), global_variables({}), functions({}) {
-    // scan for global variables
-    this->scan_global_variables(insts);
+Program::Program(vector<Instruction>& insts, SymbolTable&& _symbols, bool use_arena, int jobs)
+    : symbols(std::move(_symbols)), global_variables({}), functions({}), instruction_cnt(insts.size()) {
     // Divide the entire program into several functions for further processing
+    // Each function is built straight from its range of insts, without a temporary copy
+    struct Range {
+        Instruction* first;
+        Instruction* last;
+        bool is_main;
+    };
+    vector<Range> ranges;
     bool _is_main = false;
-    vector<Instruction> tmp = {};
-    for (const auto& inst : insts) {
+    Instruction* first = nullptr;
+    for (auto& inst : insts) {
         if (inst.opcode.type == Opcode::Type::ENTRYPC) {
             _is_main = true;
             continue;
         }
-        if (tmp.empty() && inst.opcode.type == Opcode::Type::NOP)
+        if (first == nullptr && inst.opcode.type == Opcode::Type::NOP)
             continue;
-        tmp.push_back(inst);
+        if (first == nullptr)
+            first = &inst;
         if (inst.opcode.type == Opcode::RET) {
-            functions.emplace_back(tmp, _is_main);
+            ranges.push_back({first, &inst + 1, _is_main});
             _is_main = false;
-            tmp = {};
+            first = nullptr;
+        }
+    }
+
+    // Functions are independent: build them in contiguous groups, each with
+    // its own arena and global variable list, and join the groups in order.
+    // The global variables only need a merge, as layout sorts them anyway.
+    size_t groups = jobs <= 1 ? 1 : std::max<size_t>(1, std::min(ranges.size(), size_t(jobs) * 4));
+    if (use_arena) {
+        for (size_t g = 0; g < groups; g++) {
+            auto size = insts.size() / groups * sizeof(Instruction) * 3 / 2;
+            arenas.emplace_back(new std::pmr::monotonic_buffer_resource(size));
         }
     }
+    vector<vector<Function>> built(groups);
+    vector<vector<Variable>> globals(groups);
+    parallel_for(groups, jobs, [&](size_t g) {
+        auto begin = ranges.size() * g / groups;
+        auto end = ranges.size() * (g + 1) / groups;
+        built[g].reserve(end - begin);
+        for (auto i = begin; i < end; i++) {
+            scan_global_variables(ranges[i].first, ranges[i].last, globals[g]);
+            built[g].emplace_back(ranges[i].first, ranges[i].last, symbols, resource(g), ranges[i].is_main);
+        }
+    });
+    functions.reserve(ranges.size());
+    for (size_t g = 0; g < groups; g++) {
+        global_variables.insert(global_variables.end(), globals[g].begin(), globals[g].end());
+        functions.insert(functions.end(), std::make_move_iterator(built[g].begin()), std::make_move_iterator(built[g].end()));
+    }
+    this->layout_global_variables();
+    // passes only edit instructions in place, so the arenas are never allocated from concurrently
+    if (jobs > 1)
+        pool = std::make_shared<ThreadPool>(jobs);
 #ifdef PROGRAM_DEBUG
     std::cout << "program" << std::endl;
     std::cout << "--global variables---" << std::endl;
@@ -60,14 +102,29 @@ Program::Program(vector<Instruction>& insts) : instruction_cnt(insts.size()), gl
 #endif
 }
 
-string Program::ccode()const {
+std::pmr::memory_resource* Program::resource(size_t group) const {
+    if (group < arenas.size())
+        return arenas[group].get();
+    return std::pmr::new_delete_resource();
+}
+
+Program::Program(SymbolTable&& _symbols)
+    : symbols(std::move(_symbols)), global_variables({}), functions({}), instruction_cnt(0) {
+}
+
+string Program::ccode_prelude() {
     std::stringstream tmp;
     tmp << "#include <stdio.h>" << std::endl;
     tmp << "#define long long long" << std::endl;
     tmp << "#define WriteLine() printf(\"\\n\");" << std::endl;
     tmp << "#define WriteLong(x) printf(\" %lld\", (long)x);" << std::endl;
     tmp << "#define ReadLong(a) if (fscanf(stdin, \"%lld\", &a) != 1) a = 0;" << std::endl;
-    tmp << "long REG[" << this->instruction_cnt + 4 << "];" << std::endl;
+    return tmp.str();
+}
+
+string Program::ccode(bool structured) const {
+    std::stringstream tmp;
+    tmp << ccode_prelude();
 
     for (auto& v : global_variables) {
         tmp << "long " << v.variable_name;
@@ -76,35 +133,90 @@ string Program::ccode()const {
         tmp << ";";
         tmp << std::endl;
     }
-    for (auto& f : functions) {
-        tmp << f.ccode() << std::endl;
+    // each function into its own slot, joined in order
+    vector<string> codes(functions.size());
+    for_each_function([&](size_t i) { codes[i] = functions[i].ccode(symbols, structured); });
+    for (auto& code : codes) {
+        tmp << code << std::endl;
     }
     return tmp.str();
 }
 string Program::icode() const{
     std::stringstream tmp;
-    for (auto& func : functions) {
-        tmp << func.icode();
+    vector<string> codes(functions.size());
+    for_each_function([&](size_t i) { codes[i] = functions[i].icode(symbols); });
+    for (auto& code : codes) {
+        tmp << code;
     }
     return tmp.str();
 }
 string Program::cfg() const{
     std::stringstream tmp;
-    for (auto& func : functions) {
-        tmp << func.cfg();
+    vector<string> codes(functions.size());
+    for_each_function([&](size_t i) { codes[i] = functions[i].cfg(); });
+    for (auto& code : codes) {
+        tmp << code;
     }
     return tmp.str();
 }
-void Program::scp(){
-    for(auto & func:functions){
-        func.scp_peephole();
+string Program::cfg_analysis() {
+    std::stringstream tmp;
+    vector<string> codes(functions.size());
+    for_each_function([&](size_t i) { codes[i] = functions[i].cfg_analysis(); });
+    for (auto& code : codes) {
+        tmp << code;
+    }
+    return tmp.str();
+}
+void Program::for_each_task(size_t n, const std::function<void(size_t)>& body) const {
+    if (pool) {
+        pool->for_each(n, body);
+    } else {
+        for (size_t i = 0; i < n; i++)
+            body(i);
     }
 }
+void Program::for_each_function(const std::function<void(size_t)>& body) const {
+    for_each_task(functions.size(), body);
+}
+void Program::scp(){
+    for_each_function([&](size_t i) { functions[i].scp_peephole(); });
+}
 void Program::dse(){
-    for(auto &func:functions){
-        func.dse();
+    for_each_function([&](size_t i) { functions[i].dse(); });
+}
+void Program::gvn(){
+    for_each_function([&](size_t i) { functions[i].gvn(); });
+}
+void Program::licm(){
+    // licm rebuilds the blocks of the functions it changes: with arenas, which
+    // are not thread-safe, the functions of a group must not do so concurrently
+    auto body = [&](size_t i) { functions[i].licm(symbols); };
+    if (arenas.empty()) {
+        for_each_function(body);
+    } else {
+        for (size_t i = 0; i < functions.size(); i++)
+            body(i);
     }
 }
+void Program::reduce_strength(){
+    // the new variables and registers are interned as they are made, so one function at a time
+    advance_next_label();
+    for (auto& func : functions)
+        func.reduce_strength(symbols, next_label);
+    renumber();
+}
+void Program::simplify_cfg(){
+    // like licm, it rebuilds the blocks of the functions it changes
+    auto body = [&](size_t i) { functions[i].simplify_cfg(symbols); };
+    if (arenas.empty()) {
+        for_each_function(body);
+    } else {
+        for (size_t i = 0; i < functions.size(); i++)
+            body(i);
+    }
+    renumber();
+}
 void Program::scp_report()const{
     for (const auto & func:functions){
         std::cout<<"Function: "<<func.id<<std::endl;
@@ -116,4 +228,42 @@ void Program::dse_report()const{
         std::cout<<"Function: "<<func.id<<std::endl;
         std::cout<<"Number of statements eliminated: "<<func.statement_eliminated_cnt<<std::endl;
     }
+}
+void Program::gvn_report()const{
+    for (const auto & func:functions){
+        std::cout<<"Function: "<<func.id<<std::endl;
+        std::cout<<"Number of expressions eliminated: "<<func.expressions_eliminated_cnt<<std::endl;
+    }
+}
+void Program::licm_report()const{
+    for (const auto & func:functions){
+        std::cout<<"Function: "<<func.id<<std::endl;
+        std::cout<<"Number of instructions hoisted: "<<func.instructions_hoisted_cnt<<std::endl;
+    }
+}
+void Program::ivs_report()const{
+    for (const auto & func:functions){
+        std::cout<<"Function: "<<func.id<<std::endl;
+        std::cout<<"Number of multiplications reduced: "<<func.multiplications_reduced_cnt<<std::endl;
+    }
+}
+void Program::inline_report()const{
+    for (const auto & func:functions){
+        std::cout<<"Function: "<<func.id<<std::endl;
+        std::cout<<"Number of calls inlined: "<<func.calls_inlined_cnt<<std::endl;
+    }
+}
+void Program::simplify_cfg_report()const{
+    for (const auto & func:functions){
+        std::cout<<"Function: "<<func.id<<std::endl;
+        std::cout<<"Number of blocks removed: "<<func.blocks_removed_cnt<<std::endl;
+        std::cout<<"Number of branches removed: "<<func.branches_removed_cnt<<std::endl;
+    }
+}
+void Program::dataflow_report() const {
+    for (const auto& func : functions) {
+        std::cerr << "Function: " << func.id << std::endl;
+        std::cerr << "Basic blocks: " << func.basic_blocks.size() << std::endl;
+        std::cerr << "Dataflow iterations: " << func.dataflow_iterations << std::endl;
+    }
 }
\ No newline at end of file
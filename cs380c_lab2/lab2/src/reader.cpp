@@ -0,0 +1,272 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+
+#include "ir.h"
+#include "parallel.h"
+InputBuffer::InputBuffer(int fd) : data(nullptr), length(0), mapped(false) {
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            madvise(p, st.st_size, MADV_SEQUENTIAL);
+            data = static_cast<char*>(p);
+            length = st.st_size;
+            mapped = true;
+            return;
+        }
+    }
+    // pipes and terminals: read in large chunks, doubling the buffer
+    size_t capacity = 1 << 20;
+    data = static_cast<char*>(malloc(capacity));
+    assert(data != nullptr);
+    while (true) {
+        if (length == capacity) {
+            capacity *= 2;
+            data = static_cast<char*>(realloc(data, capacity));
+            assert(data != nullptr);
+        }
+        auto cnt = read(fd, data + length, capacity - length);
+        if (cnt <= 0)
+            break;
+        length += cnt;
+    }
+}
+
+InputBuffer::~InputBuffer() {
+    if (mapped)
+        munmap(data, length);
+    else
+        free(data);
+}
+
+long long to_ll(string_view s) {
+    long long val = 0;
+    size_t i = 0;
+    while (i < s.size() && s[i] == ' ')
+        ++i;
+    if (i < s.size() && s[i] == '+')
+        ++i;
+    std::from_chars(s.data() + i, s.data() + s.size(), val);
+    return val;
+}
+
+vector<Instruction> parse_instructions(string_view text, SymbolTable& symbols) {
+    vector<Instruction> instrs;
+    // csc emits roughly 25 bytes per instruction
+    instrs.reserve(text.size() / 25 + 1);
+    size_t pos = 0;
+    while (pos < text.size()) {
+        auto eol = text.find('\n', pos);
+        if (eol == string_view::npos)
+            eol = text.size();
+        auto line = text.substr(pos, eol - pos);
+        pos = eol + 1;
+        auto first = line.find_first_not_of(" \t");
+        if (first != string_view::npos && line.compare(first, 5, "instr") == 0)
+            instrs.emplace_back(line.substr(first + 5), symbols);
+    }
+    return instrs;
+}
+
+
+// The end of the line holding the first ret at or after pos, or the end of the text
+static size_t after_next_ret(string_view text, size_t pos) {
+    while (pos < text.size()) {
+        auto eol = text.find('\n', pos);
+        if (eol == string_view::npos)
+            eol = text.size();
+        auto line = text.substr(pos, eol - pos);
+        pos = eol + 1;
+        auto colon = line.find(':');
+        if (colon == string_view::npos || line.find("instr") > colon)
+            continue;
+        auto op = line.find_first_not_of(" \t", colon + 1);
+        if (op != string_view::npos && line.compare(op, 3, "ret") == 0)
+            return std::min(pos, text.size());
+    }
+    return text.size();
+}
+
+vector<Instruction> parse_instructions(string_view text, SymbolTable& symbols, int jobs) {
+    if (jobs <= 1)
+        return parse_instructions(text, symbols);
+    // a few chunks per thread, so one large function does not hold up the rest
+    const size_t chunks = size_t(jobs) * 4;
+    vector<size_t> bounds{0};
+    for (size_t k = 1; k < chunks; k++)
+        bounds.push_back(std::max(bounds.back(), after_next_ret(text, text.size() * k / chunks)));
+    bounds.push_back(text.size());
+
+    vector<vector<Instruction>> parts(chunks);
+    vector<SymbolTable> tables(chunks);
+    parallel_for(chunks, jobs, [&](size_t k) {
+        parts[k] = parse_instructions(text.substr(bounds[k], bounds[k + 1] - bounds[k]), tables[k]);
+    });
+    // hand out the global ids in chunk order, then rewrite every chunk to them
+    vector<vector<uint32_t>> id_maps;
+    for (const auto& table : tables)
+        id_maps.push_back(symbols.merge(table));
+    parallel_for(chunks, jobs, [&](size_t k) {
+        const auto& id_map = id_maps[k];
+        for (auto& inst : parts[k]) {
+            if (inst.symbol != SymbolTable::NONE)
+                inst.symbol = id_map[inst.symbol];
+            for (auto& operand : inst.operands) {
+                if (operand.symbol != SymbolTable::NONE)
+                    operand.symbol = id_map[operand.symbol];
+            }
+        }
+    });
+    size_t total = 0;
+    for (const auto& part : parts)
+        total += part.size();
+    vector<Instruction> instrs;
+    instrs.reserve(total);
+    for (const auto& part : parts)
+        instrs.insert(instrs.end(), part.begin(), part.end());
+    return instrs;
+}
+
+static_assert(int(CSIRadd) == Opcode::ADD && int(CSIRneg) == Opcode::NEG && int(CSIRbr) == Opcode::BR &&
+                  int(CSIRload) == Opcode::LOAD && int(CSIRparam) == Opcode::PARAM && int(CSIRret) == Opcode::RET &&
+                  int(CSIRnop) == Opcode::NOP,
+              "csir.h opcodes are numbered as Opcode::Type");
+
+bool is_binary_ir(string_view data) {
+    return data.substr(0, 4) == CSIR_MAGIC;
+}
+
+vector<Instruction> parse_binary_instructions(string_view data, SymbolTable& symbols, string& error) {
+    auto p = reinterpret_cast<const unsigned char*>(data.data());
+    auto end = p + data.size();
+    // the first problem found; the rest of the input is skipped after it
+    auto fail = [&](const char* what) {
+        if (error.empty())
+            error = what;
+        p = end;
+    };
+    auto varint = [&]() {
+        unsigned long long v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p == end)
+                break;
+            auto c = *p++;
+            v |= (unsigned long long)(c & 0x7f) << shift;
+            if (c < 0x80)
+                return v;
+        }
+        fail("truncated or overlong integer");
+        return 0ULL;
+    };
+    auto zigzag = [&]() {
+        auto v = varint();
+        return (long long)(v >> 1) ^ -(long long)(v & 1);
+    };
+
+    if (!is_binary_ir(data) || data.size() < 6) {
+        error = "no CSIR header";
+        return {};
+    }
+    p += 4;
+    if (*p++ != CSIR_VERSION) {
+        error = "unsupported CSIR version";
+        return {};
+    }
+    auto flags = *p++;
+    // every name is interned once, operands then refer to it by id
+    auto name_cnt = varint();
+    // each name takes at least its length byte
+    if (name_cnt > (unsigned long long)(end - p))
+        fail("symbol count past the end of the input");
+    vector<uint32_t> names(error.empty() ? name_cnt : 0);
+    for (auto& name : names) {
+        auto len = varint();
+        if (len > (unsigned long long)(end - p)) {
+            fail("symbol name past the end of the input");
+            return {};
+        }
+        name = symbols.intern_name(string_view(reinterpret_cast<const char*>(p), len));
+        p += len;
+    }
+    vector<Instruction> instrs;
+    // a count no input could hold is not reserved
+    instrs.reserve(std::min<unsigned long long>(varint(), end - p));
+    if (flags & CSIRFunctionIndex) {
+        // the index only matters to readers that seek to a function
+        for (auto funcs = varint(); funcs > 0 && p < end; funcs--) {
+            varint();
+            varint();
+        }
+    }
+    auto body_len = varint();
+    if (error.empty() && body_len != (unsigned long long)(end - p))
+        fail("body length does not match the input");
+    long long label = 0;
+    while (p < end) {
+        if (*p <= Opcode::INVALID || *p >= Opcode::ASSIGN) {
+            fail("unknown opcode");
+            break;
+        }
+        Opcode opcode(static_cast<Opcode::Type>(*p++));
+        // the blocks are cut on the assumption that labels run on one by one
+        auto delta = varint();
+        if (delta == 0 || (!instrs.empty() && delta != 1)) {
+            fail("labels out of sequence");
+            break;
+        }
+        label += delta;
+        auto& inst = instrs.emplace_back(label, opcode, symbols);
+        auto is_function = (opcode.type == Opcode::Type::CALL);
+        for (int k = 0; k < opcode.operand_cnt(); k++) {
+            if (p == end) {
+                fail("instruction cut short");
+                break;
+            }
+            auto form = *p++;
+            if (form > CSIRField) {
+                fail("unknown operand form");
+                break;
+            }
+            uint32_t name = 0;
+            if (form == CSIRVar || form == CSIRBase || form == CSIRField) {
+                auto index = varint();
+                if (index >= names.size()) {
+                    fail("symbol index out of range");
+                    break;
+                }
+                name = names[index];
+            }
+            long long value = 0;
+            if (form == CSIRReg || form == CSIRLabel)
+                value = varint();
+            else if (form != CSIRGP && form != CSIRFP)
+                value = zigzag();
+            inst.operands.emplace_back(form, name, value, symbols, is_function);
+        }
+    }
+    // registers and branch targets must name instructions of their own
+    // function, from its enter up to the next ret
+    for (size_t first = 0, last; error.empty() && first < instrs.size(); first = last + 1) {
+        last = first;
+        while (last + 1 < instrs.size() && instrs[last].opcode.type != Opcode::Type::RET)
+            last++;
+        for (auto i = first; i <= last; i++) {
+            for (const auto& operand : instrs[i].operands) {
+                auto target = operand.type == Operand::Type::REG     ? operand.reg_name
+                              : operand.type == Operand::Type::LABEL ? operand.inst_label
+                                                                     : instrs[first].label;
+                if (target < instrs[first].label || target > instrs[last].label)
+                    fail("operand refers to no instruction of its function");
+            }
+        }
+    }
+    if (!error.empty())
+        return {};
+    return instrs;
+}
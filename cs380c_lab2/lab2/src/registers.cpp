@@ -0,0 +1,158 @@
+#include <algorithm>
+
+#include "dataflow.h"
+#include "ir.h"
+// Registers are indexed by label - id. The arguments of a call are read
+// only by the call itself, so the registers its params pass stay live up
+// to it. Every def interferes with the registers live right after it, and
+// in label order each register takes the lowest slot none of its
+// neighbours has.
+RegisterSlots Function::allocate_registers(const SymbolTable& symbols) const {
+    RegisterSlots regs;
+    regs.label_0 = id;
+    const auto reg_cnt = basic_blocks.back().last_label() - id + 1;
+    const auto bb_cnt = basic_blocks.size();
+
+    // the registers each call reads through its params
+    unordered_map<long long, vector<long long>> args_of_call;
+    for (const auto& bb : basic_blocks) {
+        vector<long long> args;
+        for (const auto& inst : bb.instructions) {
+            if (inst.opcode.type == Opcode::Type::PARAM) {
+                if (inst.operands[0].type == Operand::Type::REG)
+                    args.push_back(inst.operands[0].reg_name - id);
+            } else if (inst.opcode.type == Opcode::Type::CALL) {
+                args_of_call[inst.label] = std::move(args);
+                args.clear();
+            }
+        }
+    }
+    // Call f on each register the instruction reads
+    auto for_each_use = [&](const Instruction& inst, auto f) {
+        if (inst.opcode.type == Opcode::Type::PARAM)
+            return;
+        if (inst.opcode.type == Opcode::Type::CALL) {
+            auto iter = args_of_call.find(inst.label);
+            if (iter != args_of_call.end())
+                std::for_each(iter->second.begin(), iter->second.end(), f);
+            return;
+        }
+        for (const auto& operand : inst.operands) {
+            if (operand.type == Operand::Type::REG)
+                f(operand.reg_name - id);
+        }
+    };
+    auto defines = [](const Instruction& inst) { return inst.opcode.info().def == Opcode::DEF_REG; };
+
+    // Most registers are read only in the block defining them; liveness
+    // across blocks is solved for the others alone, indexed densely
+    vector<int> def_block(reg_cnt, -1), global_index(reg_cnt, -1);
+    vector<char> is_reg(reg_cnt, false);
+    for (size_t b = 0; b < bb_cnt; b++) {
+        for (const auto& inst : basic_blocks[b].instructions) {
+            for_each_use(inst, [&](long long r) {
+                is_reg[r] = true;
+                if (def_block[r] != b)
+                    global_index[r] = 0;
+            });
+            if (defines(inst)) {
+                is_reg[inst.label - id] = true;
+                def_block[inst.label - id] = b;
+            }
+        }
+    }
+    vector<long long> globals;
+    for (long long r = 0; r < reg_cnt; r++) {
+        if (global_index[r] == 0) {
+            global_index[r] = globals.size();
+            globals.push_back(r);
+        }
+    }
+    vector<BitVector> uses(bb_cnt, BitVector(globals.size())), defs(bb_cnt, BitVector(globals.size()));
+    for (size_t b = 0; b < bb_cnt; b++) {
+        for (const auto& inst : basic_blocks[b].instructions) {
+            for_each_use(inst, [&](long long r) {
+                if (global_index[r] >= 0 && !defs[b].test(global_index[r]))
+                    uses[b].set(global_index[r]);
+            });
+            if (defines(inst) && global_index[inst.label - id] >= 0)
+                defs[b].set(global_index[inst.label - id]);
+        }
+    }
+    auto flow = solve_dataflow<Direction::BACKWARD, Meet::UNION>(*this, globals.size(), GenKill{uses, defs});
+
+    // walk each block backwards with the live registers in a list
+    vector<vector<int>> neighbours(reg_cnt);
+    vector<int> live, position(reg_cnt, -1);
+    auto make_live = [&](long long r) {
+        if (position[r] < 0) {
+            position[r] = live.size();
+            live.push_back(r);
+        }
+    };
+    auto make_dead = [&](long long r) {
+        if (position[r] < 0)
+            return;
+        position[live.back()] = position[r];
+        live[position[r]] = live.back();
+        live.pop_back();
+        position[r] = -1;
+    };
+    for (size_t b = 0; b < bb_cnt; b++) {
+        flow.outs[b].for_each([&](size_t g) { make_live(globals[g]); });
+        const auto& instructions = basic_blocks[b].instructions;
+        for (auto iter = instructions.rbegin(); iter != instructions.rend(); ++iter) {
+            if (defines(*iter)) {
+                const int d = iter->label - id;
+                make_dead(d);
+                for (int r : live) {
+                    neighbours[d].push_back(r);
+                    neighbours[r].push_back(d);
+                }
+            }
+            for_each_use(*iter, make_live);
+        }
+        while (!live.empty())
+            make_dead(live.back());
+    }
+
+    regs.slot_of.assign(reg_cnt, -1);
+    vector<int> taken_by;  // per slot, the last register that found a neighbour in it
+    for (int r = 0; r < reg_cnt; r++) {
+        if (!is_reg[r])
+            continue;
+        for (int n : neighbours[r]) {
+            if (regs.slot_of[n] >= 0)
+                taken_by[regs.slot_of[n]] = r;
+        }
+        int slot = 0;
+        while (slot < taken_by.size() && taken_by[slot] == r)
+            slot++;
+        if (slot == taken_by.size())
+            taken_by.push_back(-1);
+        regs.slot_of[r] = slot;
+    }
+    regs.slot_cnt = taken_by.size();
+
+    // the slots must not hide a variable the function names
+    auto is_taken = [&](const string& name) {
+        return name.size() > regs.prefix.size() && name.compare(0, regs.prefix.size(), regs.prefix) == 0 &&
+               std::all_of(name.begin() + regs.prefix.size(), name.end(), [](char c) { return c >= '0' && c <= '9'; });
+    };
+    vector<string> names;
+    for (const auto& v : local_variables)
+        names.push_back(v.variable_name);
+    for (const auto& v : params)
+        names.push_back(v.variable_name);
+    for (const auto& bb : basic_blocks) {
+        for (const auto& inst : bb.instructions) {
+            for (const auto& operand : inst.operands) {
+                if (operand.is_global())
+                    names.push_back(symbols.name(operand.symbol));
+            }
+        }
+    }
+    while (std::any_of(names.begin(), names.end(), is_taken))
+        regs.prefix = "t" + regs.prefix;
+    return regs;
+}
@@ -0,0 +1,172 @@
+#include <algorithm>
+
+#include "ir.h"
+namespace {
+bool is_conditional(const Instruction& inst) {
+    return inst.opcode.type == Opcode::Type::BLBC || inst.opcode.type == Opcode::Type::BLBS;
+}
+}  // namespace
+
+// The blocks are worked on as copies, in layout order, until nothing
+// changes, and the function is rebuilt once at the end:
+// - a blbc or blbs on a constant 0 or 1, read directly or through the
+//   assign scp left behind, becomes a br when it is taken and a nop when not
+// - a branch to a block holding nothing but nops and a br goes on to the
+//   target of that br, and one to a block of nops to the block after it
+// - a branch to the block it would fall into anyway becomes a nop
+// - a block no path from the enter reaches is dropped
+// - a block whose only predecessor branches to it with a br, and which ends
+//   in a br itself, moves up in place of that br
+// A block left without a branch at its end, that nothing else branches to,
+// joins the block before it when the blocks are rebuilt.
+void Function::simplify_cfg(const SymbolTable& symbols) {
+    const int n = basic_blocks.size();
+    const long long blocks_before = n;
+    long long branches_before = 0;
+    vector<vector<Instruction>> blocks(n);
+    for (int b = 0; b < n; b++) {
+        blocks[b].assign(basic_blocks[b].instructions.begin(), basic_blocks[b].instructions.end());
+        branches_before += blocks[b].back().is_branch();
+    }
+    // labels are contiguous, so the instruction defining a register is found by its label
+    auto def_of = [&](long long label) -> const Instruction& {
+        auto bb = std::upper_bound(basic_blocks.begin(), basic_blocks.end(), label,
+                                   [](long long label, const BasicBlock& bb) { return label < bb.first_label(); });
+        --bb;
+        return bb->instructions[label - bb->first_label()];
+    };
+    // 0 or 1 when the branch tests a known one of them, -1 otherwise
+    auto condition = [&](const Instruction& inst) -> long long {
+        auto operand = inst.operands[0];
+        if (operand.type == Operand::Type::REG) {
+            const auto& def = def_of(operand.reg_name);
+            if (def.opcode.type != Opcode::Type::ASSIGN)
+                return -1;
+            operand = def.operands[0];
+        }
+        if (operand.type != Operand::Type::CONSTANT || (operand.constant != 0 && operand.constant != 1))
+            return -1;
+        return operand.constant;
+    };
+
+    // the last block holds the ret, and the enter block is where the function starts: both stay
+    vector<char> alive(n, true);
+    auto next_alive = [&](int b) {
+        do
+            b++;
+        while (b < n && !alive[b]);
+        return b;
+    };
+    auto only_nops = [](const vector<Instruction>& insts, size_t end) {
+        return std::all_of(insts.begin(), insts.begin() + end,
+                           [](const Instruction& inst) { return inst.opcode.type == Opcode::Type::NOP; });
+    };
+    // the block a branch to b ends up in, following blocks that only pass control on
+    auto resolve = [&](int b) {
+        for (int steps = 0; steps < n && b < n - 1; steps++) {
+            const auto& insts = blocks[b];
+            const auto& last = insts.back();
+            if (last.opcode.type == Opcode::Type::BR && only_nops(insts, insts.size() - 1))
+                b = idx_of_bb.at(last.branch_target_label());
+            else if (!last.is_branch() && only_nops(insts, insts.size()))
+                b = next_alive(b);
+            else
+                break;
+        }
+        return b;
+    };
+
+    bool changed = true;
+    bool changed_any = false;
+    while (changed) {
+        changed = false;
+        for (int b = 0; b < n; b++) {
+            if (!alive[b])
+                continue;
+            auto& last = blocks[b].back();
+            if (is_conditional(last)) {
+                const auto value = condition(last);
+                if (value >= 0) {
+                    const bool taken = (value == 0) == (last.opcode.type == Opcode::Type::BLBC);
+                    if (taken) {
+                        const auto target = last.operands.back();
+                        last.opcode.type = Opcode::Type::BR;
+                        last.operands.clear();
+                        last.operands.push_back(target);
+                    } else {
+                        last.to_nop();
+                    }
+                    changed = true;
+                }
+            }
+            if (!last.is_branch())
+                continue;
+            const int target = resolve(idx_of_bb.at(last.branch_target_label()));
+            if (target < n && blocks[target].front().label != last.branch_target_label()) {
+                last.operands.back().inst_label = blocks[target].front().label;
+                changed = true;
+            }
+            if (target == next_alive(b)) {
+                last.to_nop();
+                changed = true;
+            }
+        }
+
+        // reachability from the enter, and the predecessors of every block
+        vector<int> preds(n, 0);
+        vector<char> reached(n, false);
+        vector<int> stack = {0};
+        reached[0] = true;
+        while (!stack.empty()) {
+            const int b = stack.back();
+            stack.pop_back();
+            const auto& last = blocks[b].back();
+            int succs[2], cnt = 0;
+            if (last.is_branch())
+                succs[cnt++] = idx_of_bb.at(last.branch_target_label());
+            if (last.opcode.type != Opcode::Type::BR && last.opcode.type != Opcode::Type::RET && next_alive(b) < n)
+                succs[cnt++] = next_alive(b);
+            for (int k = 0; k < cnt; k++) {
+                preds[succs[k]]++;
+                if (!reached[succs[k]]) {
+                    reached[succs[k]] = true;
+                    stack.push_back(succs[k]);
+                }
+            }
+        }
+        for (int b = 1; b < n - 1; b++) {
+            if (alive[b] && !reached[b]) {
+                alive[b] = false;
+                changed = true;
+            }
+        }
+
+        for (int b = 0; b < n; b++) {
+            if (!alive[b] || blocks[b].back().opcode.type != Opcode::Type::BR)
+                continue;
+            const int c = idx_of_bb.at(blocks[b].back().branch_target_label());
+            if (c == 0 || c == b || c == n - 1 || preds[c] != 1 || blocks[c].back().opcode.type != Opcode::Type::BR)
+                continue;
+            blocks[b].pop_back();
+            blocks[b].insert(blocks[b].end(), blocks[c].begin(), blocks[c].end());
+            // the successor of c has b for a predecessor instead, so the counts still hold
+            alive[c] = false;
+            changed = true;
+        }
+        changed_any |= changed;
+    }
+    if (!changed_any)
+        return;
+
+    vector<Instruction> insts;
+    long long branches_after = 0;
+    for (int b = 0; b < n; b++) {
+        if (!alive[b])
+            continue;
+        insts.insert(insts.end(), blocks[b].begin(), blocks[b].end());
+        branches_after += blocks[b].back().is_branch();
+    }
+    branches_removed_cnt += branches_before - branches_after;
+    relabel(insts, symbols);
+    blocks_removed_cnt += blocks_before - basic_blocks.size();
+}
@@ -0,0 +1,138 @@
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "ir.h"
+bool Program::stream(int fd, bool do_scp, bool do_dse, bool do_rep, const string& backend, std::ostream& out) {
+    // read in fixed chunks; a line split across two chunks is carried over
+    vector<char> buffer(1 << 16);
+    // the binary IR is decoded whole, so streaming takes text only: enough of
+    // the input to tell is read before anything is emitted
+    size_t head = 0;
+    for (ssize_t cnt; head < 4 && (cnt = read(fd, buffer.data() + head, buffer.size() - head)) > 0;)
+        head += cnt;
+    if (is_binary_ir(string_view(buffer.data(), head)))
+        return false;
+
+    bool emit_c = backend.size() == 1 && backend[0] == 'c';
+    bool emit_cfg = backend.find("cfg") != string::npos;
+    bool emit_3addr = backend.find("3addr") != string::npos;
+    // the dse report follows every scp report in the batch output, so hold it back
+    std::stringstream dse_rep;
+    // global symbol -> declared as a scalar (true) or as an array (false)
+    std::unordered_map<uint32_t, bool> declared;
+
+    if (emit_c) {
+        out << ccode_prelude();
+    }
+
+    auto finish_function = [&](vector<Instruction>& pending, bool _is_main) {
+        auto first = pending.data();
+        auto last = first + pending.size();
+        scan_global_variables(first, last, global_variables);
+        functions.emplace_back(first, last, symbols, resource(), _is_main);
+        auto& func = functions.back();
+        if (do_scp) {
+            func.scp_peephole();
+            if (do_rep) {
+                out << "Function: " << func.id << std::endl;
+                out << "Number of constants propagated: " << func.constant_propagated_cnt << std::endl;
+            }
+        }
+        if (do_dse) {
+            func.dse();
+            if (do_rep) {
+                dse_rep << "Function: " << func.id << std::endl;
+                dse_rep << "Number of statements eliminated: " << func.statement_eliminated_cnt << std::endl;
+            }
+        }
+        if (emit_c) {
+            // A global read or written directly is a scalar; one only reached
+            // through its address is declared as an array.
+            std::unordered_map<uint32_t, bool> seen;
+            for (const auto& bb : func.basic_blocks) {
+                for (const auto& inst : bb.instructions) {
+                    for (const auto& operand : inst.operands) {
+                        if (!operand.is_global())
+                            continue;
+                        seen[operand.symbol] |= operand.type == Operand::Type::GLOBAL_VARIABLE;
+                    }
+                }
+            }
+            for (const auto& [symbol, is_scalar] : seen) {
+                auto iter = declared.find(symbol);
+                if (iter != declared.end()) {
+                    assert(!is_scalar || iter->second);
+                    continue;
+                }
+                declared[symbol] = is_scalar;
+                out << "extern long " << symbols.name(symbol) << (is_scalar ? "" : "[]") << ";" << std::endl;
+            }
+            out << func.ccode(symbols) << std::endl;
+        } else if (emit_cfg) {
+            out << func.cfg();
+        } else if (emit_3addr) {
+            out << func.icode(symbols);
+        }
+        functions.clear();
+        pending.clear();
+    };
+
+    vector<Instruction> pending;
+    bool _is_main = false;
+    auto take_line = [&](string_view line) {
+        auto first = line.find_first_not_of(" \t");
+        if (first == string_view::npos || line.compare(first, 5, "instr") != 0)
+            return;
+        Instruction inst(line.substr(first + 5), symbols);
+        instruction_cnt++;
+        if (inst.opcode.type == Opcode::Type::ENTRYPC) {
+            _is_main = true;
+            return;
+        }
+        if (pending.empty() && inst.opcode.type == Opcode::Type::NOP)
+            return;
+        pending.push_back(inst);
+        if (inst.opcode.type == Opcode::Type::RET) {
+            finish_function(pending, _is_main);
+            _is_main = false;
+        }
+    };
+
+    string carry;
+    auto take_chunk = [&](string_view chunk) {
+        size_t pos = 0;
+        for (size_t eol; (eol = chunk.find('\n', pos)) != string_view::npos; pos = eol + 1) {
+            if (carry.empty()) {
+                take_line(chunk.substr(pos, eol - pos));
+            } else {
+                carry.append(chunk.substr(pos, eol - pos));
+                take_line(carry);
+                carry.clear();
+            }
+        }
+        carry.append(chunk.substr(pos));
+    };
+    take_chunk(string_view(buffer.data(), head));
+    for (ssize_t cnt; (cnt = read(fd, buffer.data(), buffer.size())) > 0;)
+        take_chunk(string_view(buffer.data(), cnt));
+    if (!carry.empty())
+        take_line(carry);
+
+    if (emit_c) {
+        // the globals are sized only now that the whole input is read
+        layout_global_variables();
+        for (auto& v : global_variables) {
+            auto symbol = symbols.intern(v.variable_name, v.address, SymbolTable::STORAGE);
+            auto iter = declared.find(symbol);
+            out << "long " << v.variable_name;
+            if (iter == declared.end() ? v.size > 8 : !iter->second)
+                out << "[" << std::max(v.size / 8, 1LL) << "]";
+            out << ";" << std::endl;
+        }
+    } else if (emit_3addr) {
+        out << std::endl;
+    }
+    out << dse_rep.str();
+    return true;
+}
@@ -0,0 +1,191 @@
+#include <algorithm>
+
+#include "ir.h"
+namespace {
+// Emits the blocks of a function in layout order as nested C statements.
+// A region is a run of blocks [lo, hi) emitted as one statement list, and
+// follow is the block control reaches when it runs off the end of the list.
+// - a block some later block of the region branches back to heads a loop
+//   up to the last such block, when nothing else branches into it: a
+//   do-while when the last block is the only one that loops back, with a
+//   conditional branch, and a while (1) otherwise
+// - a conditional branch over the blocks right after it, when nothing else
+//   branches into them, becomes an if around them, and an if-else when they
+//   end in a br over a second run entered only from the condition
+// - any other edge is a continue or a break of the innermost loop when it
+//   goes to its head or to the block after it, and a goto otherwise
+// Since every block is emitted once and in order, the gotos stay correct
+// whatever the nesting around them; only the targets of gotos get labels.
+class Structurer {
+   public:
+    Structurer(const Function& func, const SymbolTable& symbols, const RegisterSlots& regs)
+        : func(func), symbols(symbols), regs(regs), n(func.basic_blocks.size()), target(n, -1), preds(n),
+          latch(n, -1), label_line(n, 0), goto_target(n, false) {
+        for (int b = 0; b < n; b++) {
+            const auto& bb = func.basic_blocks[b];
+            if (bb.instructions.back().is_branch())
+                target[b] = func.idx_of_bb.at(bb.instructions.back().branch_target_label());
+            for (auto label : bb.predecessor_labels)
+                preds[b].push_back(func.idx_of_bb.at(label));
+            if (target[b] >= 0 && target[b] <= b)
+                latch[target[b]] = std::max(latch[target[b]], b);
+        }
+    }
+
+    string emit() {
+        region(0, n, -1, Loop{-1, -1}, 0, -1);
+        std::stringstream tmp;
+        for (int b = 0; b < n; b++) {
+            if (goto_target[b])
+                lines[label_line[b]] += "inst_" + std::to_string(func.basic_blocks[b].first_label()) + ":;";
+        }
+        for (const auto& line : lines) {
+            if (!line.empty())
+                tmp << line << std::endl;
+        }
+        return tmp.str();
+    }
+
+   private:
+    // The loop break and continue refer to: the block after it and its
+    // head, -1 for a do-while, where a continue would test the condition
+    struct Loop {
+        int exit, head;
+    };
+
+    const Function& func;
+    const SymbolTable& symbols;
+    const RegisterSlots& regs;
+    const int n;
+    vector<int> target;         // per block, where its branch goes, -1 if it has none
+    vector<vector<int>> preds;  // per block, the blocks that may run right before it
+    vector<int> latch;          // per block, the last one branching back to it, -1 if none
+    vector<string> lines;
+    vector<size_t> label_line;  // per block, the line left empty for its label
+    vector<char> goto_target;
+    vector<string> args;        // the arguments of the call being emitted
+
+    void line(int depth, const string& code) {
+        if (!code.empty())
+            lines.push_back(string(2 * depth + 2, ' ') + code);
+    }
+    // Whether every edge into [lo, hi) but those from from, or into lo, comes from inside it
+    bool closed(int lo, int hi, int from) const {
+        for (int b = lo; b < hi; b++) {
+            for (int p : preds[b]) {
+                if ((p < lo || p >= hi) && !(b == lo && (p == from || from < 0)))
+                    return false;
+            }
+        }
+        return true;
+    }
+    string jump(int to, const Loop& loop) {
+        if (to >= n)
+            return "";
+        if (to == loop.head)
+            return "continue;";
+        if (to == loop.exit)
+            return "break;";
+        goto_target[to] = true;
+        return "goto inst_" + std::to_string(func.basic_blocks[to].first_label()) + ";";
+    }
+    // The condition under which the branch ending block b is taken, or not
+    string condition(int b, bool taken) const {
+        const auto& last = func.basic_blocks[b].instructions.back();
+        const bool on_zero = (last.opcode.type == Opcode::Type::BLBC) == taken;
+        return last.operands[0].ccode(symbols, regs) + (on_zero ? " == 0" : " != 0");
+    }
+    // The label and every statement of block b but its branch
+    void body(int b, int depth) {
+        label_line[b] = lines.size();
+        lines.emplace_back();
+        for (const auto& inst : func.basic_blocks[b].instructions) {
+            if (!inst.is_branch())
+                line(depth, inst.cstatement(symbols, regs, args));
+        }
+    }
+
+    // The blocks [lo, hi), after which control goes on to follow; head is
+    // the block whose loop is being emitted, so that it starts no loop again
+    void region(int lo, int hi, int follow, const Loop& loop, int depth, int head) {
+        int b = lo;
+        while (b < hi) {
+            int next = b + 1;  // where control is once the construct at b is done
+            const int e = latch[b];
+            if (b != head && e >= 0 && e < hi && closed(b, e + 1, -1)) {
+                do_while_or_while(b, e, depth);
+                next = e + 1;
+            } else if (!conditional(b, hi, loop, depth, next)) {
+                body(b, depth);
+                const auto& last = func.basic_blocks[b].instructions.back();
+                if (last.opcode.type == Opcode::Type::BR || last.opcode.type == Opcode::Type::RET) {
+                    if (target[b] >= 0 && target[b] != (b + 1 < hi ? b + 1 : follow))
+                        line(depth, jump(target[b], loop));
+                    b++;
+                    continue;
+                }
+            }
+            // control falls out of the construct into block next
+            if (next == hi && hi != follow)
+                line(depth, jump(next, loop));
+            b = next;
+        }
+    }
+
+    void do_while_or_while(int h, int e, int depth) {
+        const bool do_while = target[e] == h && func.basic_blocks[e].instructions.back().opcode.type != Opcode::Type::BR &&
+                              std::none_of(target.begin() + h, target.begin() + e, [&](int t) { return t == h; });
+        if (do_while) {
+            line(depth, "do {");
+            region(h, e, e, Loop{e + 1, -1}, depth + 1, h);
+            body(e, depth + 1);
+            line(depth, "} while (" + condition(e, true) + ");");
+        } else {
+            line(depth, "while (1) {");
+            region(h, e + 1, h, Loop{e + 1, h}, depth + 1, h);
+            line(depth, "}");
+        }
+    }
+
+    // Block b and what its conditional branch nests, if it ends in one;
+    // next becomes the block control reaches after them
+    bool conditional(int b, int hi, const Loop& loop, int depth, int& next) {
+        const auto& last = func.basic_blocks[b].instructions.back();
+        if (last.opcode.type != Opcode::Type::BLBC && last.opcode.type != Opcode::Type::BLBS)
+            return false;
+        const int t = target[b];
+        body(b, depth);
+        next = b + 1;
+        if (t == b + 1)
+            return true;
+        // a break or continue reads better than an if around the rest of the
+        // loop; a branch back, out of the region or over blocks entered from
+        // elsewhere stays a jump
+        if (t == loop.head || t == loop.exit || t <= b || t > hi || !closed(b + 1, t, b)) {
+            line(depth, "if (" + condition(b, true) + ") " + jump(t, loop));
+            return true;
+        }
+        // if-else: the blocks up to t end in a br over those from t on
+        const int u = target[t - 1];
+        if (t - 1 > b && func.basic_blocks[t - 1].instructions.back().opcode.type == Opcode::Type::BR && u > t &&
+            u <= hi && closed(t, u, b)) {
+            line(depth, "if (" + condition(b, false) + ") {");
+            region(b + 1, t, u, loop, depth + 1, -1);
+            line(depth, "} else {");
+            region(t, u, u, loop, depth + 1, -1);
+            line(depth, "}");
+            next = u;
+            return true;
+        }
+        line(depth, "if (" + condition(b, false) + ") {");
+        region(b + 1, t, t, loop, depth + 1, -1);
+        line(depth, "}");
+        next = t;
+        return true;
+    }
+};
+}  // namespace
+
+string Function::structured_ccode(const SymbolTable& symbols, const RegisterSlots& regs) const {
+    return Structurer(*this, symbols, regs).emit();
+}
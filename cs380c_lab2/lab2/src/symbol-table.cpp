@@ -0,0 +1,57 @@
+#include <algorithm>
+
+#include "ir.h"
+uint32_t SymbolTable::intern_name(string_view name) {
+    auto name_iter = name_ids.find(name);
+    if (name_iter != name_ids.end())
+        return name_iter->second;
+    uint32_t name_id = names.size();
+    names.emplace_back(name);
+    name_ids.emplace(names.back(), name_id);
+    return name_id;
+}
+
+uint32_t SymbolTable::intern(string_view name, long long offset, Space space) {
+    return intern(intern_name(name), offset, space);
+}
+
+uint32_t SymbolTable::intern(uint32_t name_id, long long offset, Space space) {
+    Key key{name_id, offset, space};
+    if (space == REGISTER) {
+        // labels are dense, so registers skip the hash map; the window starts
+        // at the first label seen, as a table may cover only part of a program
+        if (reg_ids.empty())
+            reg_base = offset;
+        if (offset < reg_base) {
+            reg_ids.insert(reg_ids.begin(), reg_base - offset, NONE);
+            reg_base = offset;
+        }
+        if (offset - reg_base >= reg_ids.size())
+            reg_ids.resize(std::max<size_t>(offset - reg_base + 1, reg_ids.size() * 2), NONE);
+        auto& id = reg_ids[offset - reg_base];
+        if (id == NONE) {
+            id = entries.size();
+            entries.push_back(key);
+        }
+        return id;
+    }
+    auto iter = ids.find(key);
+    if (iter != ids.end())
+        return iter->second;
+    uint32_t id = entries.size();
+    entries.push_back(key);
+    ids.emplace(key, id);
+    return id;
+}
+
+vector<uint32_t> SymbolTable::merge(const SymbolTable& other) {
+    vector<uint32_t> name_map;
+    name_map.reserve(other.names.size());
+    for (const auto& name : other.names)
+        name_map.push_back(intern_name(name));
+    vector<uint32_t> id_map;
+    id_map.reserve(other.entries.size());
+    for (const auto& key : other.entries)
+        id_map.push_back(intern(name_map[key.name], key.offset, key.space));
+    return id_map;
+}
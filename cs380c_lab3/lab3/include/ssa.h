@@ -0,0 +1,62 @@
+#ifndef SSA_H
+#define SSA_H
+#include "dataflow.h"
+#include "ir.h"
+
+// The SSA form of a function, kept beside its instructions rather than in
+// them: every operand that reads a register or a variable is mapped to the
+// SSA value it reads, and phis live in per-block lists. Registers are already
+// single-assignment; local variables, parameters and globals (as
+// GLOBAL_VARIABLE) are renamed. Every variable has an entry value, and a call
+// defines a new, unknown value of every global.
+class SSAForm {
+   public:
+    enum Kind : unsigned char {
+        ENTRY,        // the value of a variable when the function is entered
+        INSTRUCTION,  // the register of an instruction, or a move to a variable
+        PHI,
+        CLOBBER,  // a global after a call
+    };
+    struct Value {
+        Kind kind;
+        int block;
+        int index;     // the instruction (INSTRUCTION, CLOBBER) or the phi (PHI) in its block
+        uint32_t var;  // the variable, NONE for registers
+    };
+    struct Phi {
+        int value;
+        uint32_t var;
+        vector<int> args;  // one value per predecessor, in DominatorTree::preds order
+    };
+    // A reader of a value: an instruction operand, or a phi when index < 0 (phi -index - 1)
+    struct Use {
+        int block;
+        int index;
+    };
+
+    const Function& func;
+    const DominatorTree& dom;
+    vector<Value> values;
+    vector<vector<Phi>> phis;                    // per block
+    vector<vector<array<int, 2>>> operand_value;  // per block and instruction, the value each operand reads, -1 if none
+    vector<vector<int>> def_value;               // per block and instruction, the value it defines, -1 if none
+    vector<vector<Use>> users;                   // per value
+
+    SSAForm(const Function& func, const DominatorTree& dom);
+    // Whether the operand names a variable that SSA renames
+    static bool is_variable(const Operand& operand);
+    // Out of SSA: join every phi with its arguments into webs and return the
+    // number of copies the webs need. Operands never stop naming their
+    // original variable and no pass moves code, so every web is made of
+    // versions of one variable and coalesces completely: the count is 0,
+    // which is why sccp() leaves the code as rewritten without calling this.
+    int lower() const;
+};
+
+// Sparse conditional constant propagation (Wegman and Zadeck) over the SSA
+// form: one sparse pass that only follows executable CFG edges. Constant
+// registers and variables are substituted into their uses, constant
+// arithmetic is folded into assign, and branches on constants become br or
+// nop. Returns the number of operands replaced by constants.
+int sccp(Function& func);
+#endif  //SSA_H
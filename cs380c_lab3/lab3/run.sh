@@ -1,3 +1,4 @@
 #!/usr/bin/env bash
 
 # A script that invokes your compiler.
+./build/lab3 "$@"
@@ -1,5 +1,67 @@
-#include<iostream>
-int main(){
-    std::cout<<"Hello world"<<std::endl;
+#include <iostream>
+#include <string>
+
+#include "ssa.h"
+
+// The lab2 command line: -opt=scp,dse and -backend=c|c-goto|cfg|cfg-analysis|3addr|rep.
+// scp here is sparse conditional constant propagation on SSA form.
+int main(int argc, char** argv) {
+    std::vector<std::string> all_args;
+    if (argc > 1) {
+        all_args.assign(argv + 1, argv + argc);
+    }
+    bool do_dse = false;
+    bool do_scp = false;
+    bool do_rep = false;
+    string backend;
+    for (auto& s : all_args) {
+        if (s.find("dse") != string::npos)
+            do_dse = true;
+        if (s.find("scp") != string::npos)
+            do_scp = true;
+        if (s.find("backend") != string::npos) {
+            backend = s.substr(s.find('=') + 1);
+        }
+    }
+    if (backend.find("rep") != string::npos) {
+        do_rep = true;
+    }
+
+    SymbolTable symbols;
+    vector<Instruction> instructions;
+    {
+        InputBuffer input(0);
+        if (is_binary_ir(input.text())) {
+            string error;
+            instructions = parse_binary_instructions(input.text(), symbols, error);
+            if (!error.empty()) {
+                std::cerr << "binary IR: " << error << std::endl;
+                return 1;
+            }
+        } else {
+            instructions = parse_instructions(input.text(), symbols);
+        }
+    }
+    auto program = Program(instructions, std::move(symbols));
+    if (do_scp) {
+        for (auto& func : program.functions)
+            func.constant_propagated_cnt = sccp(func);
+        if (do_rep) program.scp_report();
+    }
+    if (do_dse) {
+        program.dse();
+        if (do_rep) program.dse_report();
+    }
+    if (backend == "c")
+        std::cout << program.ccode();
+    else if (backend == "c-goto")
+        std::cout << program.ccode(false);
+    else if (backend == "cfg-analysis")
+        std::cout << program.cfg_analysis();
+    else if (backend.find("cfg") != string::npos)
+        std::cout << program.cfg();
+    else if (backend.find("3addr") != string::npos)
+        std::cout << program.icode() << std::endl;
+
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,285 @@
+#include <climits>
+
+#include "ssa.h"
+namespace {
+// The constant propagation lattice: TOP (no value seen yet) > CONST c > BOTTOM
+struct Lattice {
+    enum State : unsigned char { TOP, CONST, BOTTOM };
+    State state = TOP;
+    long long constant = 0;
+    bool operator==(const Lattice& o) const {
+        return state == o.state && (state != CONST || constant == o.constant);
+    }
+    bool operator!=(const Lattice& o) const { return !(*this == o); }
+    static Lattice bottom() { return {BOTTOM, 0}; }
+    static Lattice of(long long c) { return {CONST, c}; }
+};
+
+Lattice meet(const Lattice& a, const Lattice& b) {
+    if (a.state == Lattice::TOP)
+        return b;
+    if (b.state == Lattice::TOP)
+        return a;
+    if (a.state == Lattice::BOTTOM || b.state == Lattice::BOTTOM || a.constant != b.constant)
+        return Lattice::bottom();
+    return a;
+}
+
+// Fold an arithmetic opcode over constants as the C backend would evaluate it;
+// false where C leaves the result undefined
+bool fold(Opcode::Type type, long long a, long long b, long long& res) {
+    auto ua = (unsigned long long)a, ub = (unsigned long long)b;
+    switch (type) {
+        case Opcode::Type::ADD:
+            res = (long long)(ua + ub);
+            return true;
+        case Opcode::Type::SUB:
+            res = (long long)(ua - ub);
+            return true;
+        case Opcode::Type::MUL:
+            res = (long long)(ua * ub);
+            return true;
+        case Opcode::Type::DIV:
+        case Opcode::Type::MOD:
+            if (b == 0 || (a == LLONG_MIN && b == -1))
+                return false;
+            res = type == Opcode::Type::DIV ? a / b : a % b;
+            return true;
+        case Opcode::Type::NEG:
+            res = (long long)(0 - ua);
+            return true;
+        case Opcode::Type::CMPEQ:
+            res = a == b;
+            return true;
+        case Opcode::Type::CMPLE:
+            res = a <= b;
+            return true;
+        case Opcode::Type::CMPLT:
+            res = a < b;
+            return true;
+        case Opcode::Type::ASSIGN:
+            res = a;
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool is_foldable(Opcode::Type type) {
+    long long res;
+    return fold(type, 1, 1, res);
+}
+
+class SCCP {
+   private:
+    Function& func;
+    const DominatorTree& dom;
+    const SSAForm& ssa;
+    vector<Lattice> lattice;
+    vector<char> executable;              // per block
+    vector<vector<char>> edge_executable;  // per block and predecessor, in dom.preds order
+    vector<std::pair<int, int>> cfg_work;  // edges (from, to)
+    vector<int> ssa_work;                  // values whose lattice went down
+
+    Lattice operand_lattice(int b, int i, int k) const {
+        const auto& operand = func.basic_blocks[b].instructions[i].operands[k];
+        if (operand.type == Operand::Type::CONSTANT)
+            return Lattice::of(operand.constant);
+        auto value = ssa.operand_value[b][i][k];
+        if (value < 0)
+            return Lattice::bottom();
+        return lattice[value];
+    }
+    void lower_to(int value, const Lattice& l) {
+        auto res = meet(lattice[value], l);
+        if (res != lattice[value]) {
+            lattice[value] = res;
+            ssa_work.push_back(value);
+        }
+    }
+    void add_edge(int from, int to) {
+        cfg_work.emplace_back(from, to);
+    }
+    void visit_phi(int b, int k) {
+        const auto& phi = ssa.phis[b][k];
+        Lattice res;
+        for (int j = 0; j < phi.args.size(); j++) {
+            if (edge_executable[b][j] && phi.args[j] >= 0)
+                res = meet(res, lattice[phi.args[j]]);
+        }
+        lower_to(phi.value, res);
+    }
+    void visit_instruction(int b, int i) {
+        const auto& bb = func.basic_blocks[b];
+        const auto& inst = bb.instructions[i];
+        auto value = ssa.def_value[b][i];
+        if (value >= 0) {
+            Lattice res = Lattice::bottom();
+            if (inst.opcode.type == Opcode::Type::MOVE) {
+                res = operand_lattice(b, i, 0);
+            } else if (is_foldable(inst.opcode.type)) {
+                Lattice a = operand_lattice(b, i, 0);
+                Lattice c = inst.operands.size() > 1 ? operand_lattice(b, i, 1) : Lattice::of(0);
+                if (a.state == Lattice::BOTTOM || c.state == Lattice::BOTTOM)
+                    res = Lattice::bottom();
+                else if (a.state == Lattice::TOP || c.state == Lattice::TOP)
+                    res = Lattice();
+                else if (long long folded; fold(inst.opcode.type, a.constant, c.constant, folded))
+                    res = Lattice::of(folded);
+            }
+            lower_to(value, res);
+        }
+        if (i + 1 == bb.instructions.size())
+            visit_branch(b);
+    }
+    void visit_branch(int b) {
+        const auto& inst = func.basic_blocks[b].instructions.back();
+        if (inst.opcode.type != Opcode::Type::BLBC && inst.opcode.type != Opcode::Type::BLBS) {
+            for (int s : dom.succs[b])
+                add_edge(b, s);
+            return;
+        }
+        auto cond = operand_lattice(b, func.basic_blocks[b].instructions.size() - 1, 0);
+        if (cond.state == Lattice::TOP)
+            return;
+        auto taken = func.idx_of_bb.at(inst.branch_target_label());
+        auto fall = func.idx_of_bb.at(inst.label + 1);
+        if (cond.state == Lattice::BOTTOM) {
+            add_edge(b, taken);
+            add_edge(b, fall);
+        } else if ((cond.constant == 0) == (inst.opcode.type == Opcode::Type::BLBC)) {
+            add_edge(b, taken);
+        } else {
+            add_edge(b, fall);
+        }
+    }
+
+   public:
+    SCCP(Function& func, const DominatorTree& dom, const SSAForm& ssa)
+        : func(func), dom(dom), ssa(ssa), lattice(ssa.values.size()), executable(func.basic_blocks.size(), false) {
+        for (int v = 0; v < ssa.values.size(); v++) {
+            if (ssa.values[v].kind == SSAForm::ENTRY || ssa.values[v].kind == SSAForm::CLOBBER)
+                lattice[v] = Lattice::bottom();
+        }
+        for (const auto& preds : dom.preds)
+            edge_executable.emplace_back(preds.size(), false);
+    }
+
+    void run() {
+        auto enter_block = [&](int b) {
+            executable[b] = true;
+            for (int k = 0; k < ssa.phis[b].size(); k++)
+                visit_phi(b, k);
+            for (int i = 0; i < func.basic_blocks[b].instructions.size(); i++)
+                visit_instruction(b, i);
+        };
+        enter_block(0);
+        while (!cfg_work.empty() || !ssa_work.empty()) {
+            while (!cfg_work.empty()) {
+                auto [from, to] = cfg_work.back();
+                cfg_work.pop_back();
+                int j = std::find(dom.preds[to].begin(), dom.preds[to].end(), from) - dom.preds[to].begin();
+                if (edge_executable[to][j])
+                    continue;
+                edge_executable[to][j] = true;
+                if (!executable[to]) {
+                    enter_block(to);
+                } else {
+                    for (int k = 0; k < ssa.phis[to].size(); k++)
+                        visit_phi(to, k);
+                }
+            }
+            while (!ssa_work.empty()) {
+                auto value = ssa_work.back();
+                ssa_work.pop_back();
+                for (const auto& use : ssa.users[value]) {
+                    if (!executable[use.block])
+                        continue;
+                    if (use.index < 0)
+                        visit_phi(use.block, -use.index - 1);
+                    else
+                        visit_instruction(use.block, use.index);
+                }
+            }
+        }
+    }
+
+    // Drop the edge from block b to the block starting at label
+    void remove_edge(int b, long long label) {
+        auto& succs = func.basic_blocks[b].successor_labels;
+        succs.erase(std::find(succs.begin(), succs.end(), label));
+        auto& preds = func.basic_blocks[func.idx_of_bb.at(label)].predecessor_labels;
+        preds.erase(std::find(preds.begin(), preds.end(), func.basic_blocks[b].first_label()));
+    }
+
+    int rewrite() {
+        int replaced = 0;
+        for (int b = 0; b < func.basic_blocks.size(); b++) {
+            if (!executable[b])
+                continue;
+            auto& bb = func.basic_blocks[b];
+            for (int i = 0; i < bb.instructions.size(); i++) {
+                auto& inst = bb.instructions[i];
+                if (inst.opcode.type == Opcode::Type::BLBC || inst.opcode.type == Opcode::Type::BLBS) {
+                    auto cond = operand_lattice(b, i, 0);
+                    if (cond.state != Lattice::CONST)
+                        continue;
+                    auto taken = inst.branch_target_label();
+                    auto fall = inst.label + 1;
+                    if (taken == fall) {
+                        inst.to_nop();
+                    } else if ((cond.constant == 0) == (inst.opcode.type == Opcode::Type::BLBC)) {
+                        inst.opcode = Opcode(Opcode::Type::BR);
+                        inst.operands[0] = inst.operands[1];
+                        inst.operands.resize(1);
+                        remove_edge(b, fall);
+                    } else {
+                        inst.to_nop();
+                        remove_edge(b, taken);
+                    }
+                    continue;
+                }
+                const bool is_move = inst.opcode.type == Opcode::Type::MOVE;
+                for (int k = 0; k < inst.operands.size(); k++) {
+                    if (is_move && k == 1)
+                        continue;
+                    auto value = ssa.operand_value[b][i][k];
+                    if (value < 0 || lattice[value].state != Lattice::CONST)
+                        continue;
+                    inst.operands[k].type = Operand::Type::CONSTANT;
+                    inst.operands[k].symbol = SymbolTable::NONE;
+                    inst.operands[k].constant = lattice[value].constant;
+                    replaced++;
+                }
+                auto value = ssa.def_value[b][i];
+                if (!is_move && value >= 0 && lattice[value].state == Lattice::CONST && is_foldable(inst.opcode.type)) {
+                    inst.opcode = Opcode(Opcode::Type::ASSIGN);
+                    inst.operands.resize(1);
+                    inst.operands[0].type = Operand::Type::CONSTANT;
+                    inst.operands[0].symbol = SymbolTable::NONE;
+                    inst.operands[0].constant = lattice[value].constant;
+                }
+            }
+        }
+        return replaced;
+    }
+};
+}  // namespace
+
+int sccp(Function& func) {
+    const auto& dom = func.dominators();
+    SSAForm ssa(func, dom);
+    SCCP pass(func, dom, ssa);
+    pass.run();
+    // out of SSA by leaving the operands as they are: see SSAForm::lower
+    auto replaced = pass.rewrite();
+    func.invalidate_chains();
+    func.invalidate_cfg();
+    // rewrite() already made an assign of every constant result, and left
+    // the divisions fold() declines; only the add of 0 is left to clean up
+    for (auto& bb : func.basic_blocks) {
+        for (auto& inst : bb.instructions)
+            inst.peephole3();
+    }
+    return replaced;
+}
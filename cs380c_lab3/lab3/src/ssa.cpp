@@ -0,0 +1,217 @@
+#include "ssa.h"
+bool SSAForm::is_variable(const Operand& operand) {
+    switch (operand.type) {
+        case Operand::Type::LOCAL_VARIABLE:
+        case Operand::Type::PARAMETER:
+        case Operand::Type::GLOBAL_VARIABLE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+SSAForm::SSAForm(const Function& func, const DominatorTree& dom) : func(func), dom(dom) {
+    const int bb_cnt = func.basic_blocks.size();
+    const auto label_0 = func.basic_blocks.front().first_label();
+    phis.resize(bb_cnt);
+    operand_value.resize(bb_cnt);
+    def_value.resize(bb_cnt);
+
+    // number the variables densely; def_blocks: where each one is assigned
+    unordered_map<uint32_t, int> var_idx;
+    vector<uint32_t> vars;
+    vector<char> is_global;
+    vector<vector<int>> def_blocks;
+    auto var_of = [&](const Operand& operand) {
+        auto [iter, inserted] = var_idx.emplace(operand.symbol, vars.size());
+        if (inserted) {
+            vars.push_back(operand.symbol);
+            is_global.push_back(operand.type == Operand::Type::GLOBAL_VARIABLE);
+            def_blocks.emplace_back();
+        }
+        return iter->second;
+    };
+    // registers are values from the start, indexed by label - label_0
+    vector<int> reg_value;
+    vector<int> call_blocks;
+    for (int b = 0; b < bb_cnt; b++) {
+        const auto& bb = func.basic_blocks[b];
+        operand_value[b].assign(bb.instructions.size(), {-1, -1});
+        def_value[b].assign(bb.instructions.size(), -1);
+        for (int i = 0; i < bb.instructions.size(); i++) {
+            const auto& inst = bb.instructions[i];
+            for (const auto& operand : inst.operands) {
+                if (is_variable(operand))
+                    var_of(operand);
+            }
+            if (inst.opcode.type == Opcode::Type::MOVE && is_variable(inst.operands[1])) {
+                auto& blocks = def_blocks[var_of(inst.operands[1])];
+                if (blocks.empty() || blocks.back() != b)
+                    blocks.push_back(b);
+            }
+            if (inst.opcode.type == Opcode::Type::CALL && (call_blocks.empty() || call_blocks.back() != b))
+                call_blocks.push_back(b);
+            if (inst.opcode.info().def == Opcode::Def::DEF_REG) {
+                def_value[b][i] = values.size();
+                values.push_back({INSTRUCTION, b, i, SymbolTable::NONE});
+            }
+            reg_value.push_back(def_value[b][i]);
+        }
+    }
+    const int var_cnt = vars.size();
+    for (int v = 0; v < var_cnt; v++) {
+        if (is_global[v])
+            def_blocks[v].insert(def_blocks[v].end(), call_blocks.begin(), call_blocks.end());
+    }
+
+    // phis on the iterated dominance frontier of the assignments
+    vector<int> has_phi(bb_cnt, -1), in_work(bb_cnt, -1);
+    for (int v = 0; v < var_cnt; v++) {
+        vector<int> work;
+        for (int b : def_blocks[v]) {
+            if (dom.reachable(b) && in_work[b] != v) {
+                in_work[b] = v;
+                work.push_back(b);
+            }
+        }
+        while (!work.empty()) {
+            int x = work.back();
+            work.pop_back();
+            for (int y : dom.frontier[x]) {
+                if (has_phi[y] == v)
+                    continue;
+                has_phi[y] = v;
+                int value = values.size();
+                values.push_back({PHI, y, int(phis[y].size()), vars[v]});
+                phis[y].push_back({value, vars[v], vector<int>(dom.preds[y].size(), -1)});
+                if (in_work[y] != v) {
+                    in_work[y] = v;
+                    work.push_back(y);
+                }
+            }
+        }
+    }
+    users.resize(values.size());
+
+    // rename along the dominator tree, with one stack of values per variable
+    vector<vector<int>> stacks(var_cnt);
+    auto new_value = [&](Kind kind, int b, int i, int v) {
+        values.push_back({kind, b, i, vars[v]});
+        users.emplace_back();
+        stacks[v].push_back(values.size() - 1);
+        return int(values.size() - 1);
+    };
+    for (int v = 0; v < var_cnt; v++)
+        new_value(ENTRY, 0, -1, v);
+    struct Frame {
+        int block;
+        size_t next_child;
+        vector<int> pushed;  // the variables this block pushed a value for
+    };
+    vector<Frame> frames;
+    frames.push_back({0, 0, {}});
+    bool entering = true;
+    while (!frames.empty()) {
+        auto& frame = frames.back();
+        const int b = frame.block;
+        if (entering) {
+            const auto& bb = func.basic_blocks[b];
+            for (auto& phi : phis[b]) {
+                int v = var_idx[phi.var];
+                stacks[v].push_back(phi.value);
+                frame.pushed.push_back(v);
+            }
+            for (int i = 0; i < bb.instructions.size(); i++) {
+                const auto& inst = bb.instructions[i];
+                const bool is_move = inst.opcode.type == Opcode::Type::MOVE;
+                for (int k = 0; k < inst.operands.size(); k++) {
+                    const auto& operand = inst.operands[k];
+                    if (is_move && k == 1)
+                        continue;
+                    int value = -1;
+                    if (is_variable(operand)) {
+                        value = stacks[var_idx[operand.symbol]].back();
+                    } else if (operand.type == Operand::Type::REG) {
+                        auto idx = operand.reg_name - label_0;
+                        if (idx >= 0 && idx < reg_value.size())
+                            value = reg_value[idx];
+                    }
+                    operand_value[b][i][k] = value;
+                    if (value >= 0)
+                        users[value].push_back({b, i});
+                }
+                if (is_move && is_variable(inst.operands[1])) {
+                    int v = var_idx[inst.operands[1].symbol];
+                    def_value[b][i] = new_value(INSTRUCTION, b, i, v);
+                    frame.pushed.push_back(v);
+                }
+                if (inst.opcode.type == Opcode::Type::CALL) {
+                    for (int v = 0; v < var_cnt; v++) {
+                        if (is_global[v]) {
+                            new_value(CLOBBER, b, i, v);
+                            frame.pushed.push_back(v);
+                        }
+                    }
+                }
+            }
+            for (int s : dom.succs[b]) {
+                int j = std::find(dom.preds[s].begin(), dom.preds[s].end(), b) - dom.preds[s].begin();
+                for (int k = 0; k < phis[s].size(); k++) {
+                    auto& phi = phis[s][k];
+                    phi.args[j] = stacks[var_idx[phi.var]].back();
+                    users[phi.args[j]].push_back({s, -k - 1});
+                }
+            }
+        }
+        if (frame.next_child < dom.children[b].size()) {
+            int child = dom.children[b][frame.next_child++];
+            frames.push_back({child, 0, {}});
+            entering = true;
+            continue;
+        }
+        for (int v : frame.pushed)
+            stacks[v].pop_back();
+        frames.pop_back();
+        entering = false;
+    }
+}
+
+int SSAForm::lower() const {
+    vector<int> parent(values.size());
+    for (int v = 0; v < values.size(); v++)
+        parent[v] = v;
+    auto find = [&](int v) {
+        while (parent[v] != v) {
+            parent[v] = parent[parent[v]];
+            v = parent[v];
+        }
+        return v;
+    };
+    for (const auto& block_phis : phis) {
+        for (const auto& phi : block_phis) {
+            for (int arg : phi.args) {
+                if (arg >= 0)
+                    parent[find(arg)] = find(phi.value);
+            }
+        }
+    }
+    // a web that mixes variables would need a copy on every edge that leaves one
+    vector<uint32_t> var_of_web(values.size(), SymbolTable::NONE);
+    for (int v = 0; v < values.size(); v++) {
+        if (values[v].var == SymbolTable::NONE)
+            continue;
+        auto& var = var_of_web[find(v)];
+        if (var == SymbolTable::NONE)
+            var = values[v].var;
+    }
+    int copies = 0;
+    for (const auto& block_phis : phis) {
+        for (const auto& phi : block_phis) {
+            for (int arg : phi.args) {
+                if (arg >= 0 && values[arg].var != var_of_web[find(arg)])
+                    copies++;
+            }
+        }
+    }
+    return copies;
+}